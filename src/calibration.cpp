@@ -0,0 +1,120 @@
+//
+// Created on 19.10.26.
+//
+
+#include "calibration.hpp"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <cmath>
+
+#include "channel.hpp"
+
+bool CalibrationTable::set(const float *x, const float *y, const size_t len)
+{
+	if (len > max_points)
+		return false;
+	for (size_t i = 1; i < len; i++)
+		if (!(x[i] > x[i - 1]))
+			return false;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		x_points[i] = x[i];
+		y_points[i] = y[i];
+	}
+	count = static_cast<uint8_t>(len);
+	update_segments();
+	return true;
+}
+
+void CalibrationTable::clear()
+{
+	count = 0;
+	update_segments();
+}
+
+void CalibrationTable::update_segments()
+{
+	segment_start.fill(INFINITY);
+	segment_start[0] = -INFINITY;
+	slope.fill(1.0f);
+	offset.fill(0.0f);
+
+	if (count == 1)
+		offset[0] = y_points[0] - x_points[0];
+
+	// segment i runs from point i to point i + 1, the first and last one are extended to infinity
+	for (size_t i = 0; i + 1 < count; i++)
+	{
+		if (i > 0)
+			segment_start[i] = x_points[i];
+		slope[i] = (y_points[i + 1] - y_points[i]) / (x_points[i + 1] - x_points[i]);
+		offset[i] = y_points[i] - slope[i] * x_points[i];
+	}
+}
+
+namespace calibration
+{
+	struct StoredTable
+	{
+		float x[CalibrationTable::max_points];
+		float y[CalibrationTable::max_points];
+		uint8_t count;
+	};
+
+	void table_key(const size_t channel, const size_t quantity, char (&key)[8])
+	{
+		snprintf(key, sizeof key, "ch%uq%u", static_cast<unsigned>(channel), static_cast<unsigned>(quantity));
+	}
+
+	void load()
+	{
+		Preferences preferences;
+		preferences.begin("cal", true);
+		for (size_t ch = 0; ch < channels.size(); ch++)
+		{
+			for (size_t q = 0; q < calibration_quantity_count; q++)
+			{
+				char key[8];
+				table_key(ch, q, key);
+				StoredTable stored;
+				if (preferences.getBytesLength(key) != sizeof stored ||
+				    preferences.getBytes(key, &stored, sizeof stored) != sizeof stored)
+					continue;
+				channels[ch].get_calibration(static_cast<CalibrationQuantity>(q)).set(stored.x, stored.y, stored.count);
+			}
+		}
+		preferences.end();
+	}
+
+	void store()
+	{
+		Preferences preferences;
+		preferences.begin("cal", false);
+		for (size_t ch = 0; ch < channels.size(); ch++)
+		{
+			for (size_t q = 0; q < calibration_quantity_count; q++)
+			{
+				char key[8];
+				table_key(ch, q, key);
+				const CalibrationTable &table = channels[ch].get_calibration(static_cast<CalibrationQuantity>(q));
+				if (table.size() == 0)
+				{
+					preferences.remove(key);
+					continue;
+				}
+
+				StoredTable stored{};
+				stored.count = static_cast<uint8_t>(table.size());
+				for (size_t i = 0; i < table.size(); i++)
+				{
+					stored.x[i] = table.get_x(i);
+					stored.y[i] = table.get_y(i);
+				}
+				preferences.putBytes(key, &stored, sizeof stored);
+			}
+		}
+		preferences.end();
+	}
+} // namespace calibration
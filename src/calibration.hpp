@@ -0,0 +1,71 @@
+//
+// Created on 19.10.26.
+//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+enum class CalibrationQuantity : uint8_t
+{
+	voltage_setpoint,
+	current_setpoint,
+	voltage_readback,
+	current_readback,
+};
+
+constexpr size_t calibration_quantity_count{4};
+
+// piecewise linear correction through up to max_points points, linear extrapolation outside of them
+// no points: identity, one point: constant offset
+class CalibrationTable
+{
+public:
+	// must be a power of two for the search in apply()
+	static constexpr size_t max_points{16};
+
+private:
+	std::array<float, max_points> x_points{};
+	std::array<float, max_points> y_points{};
+	uint8_t count{0};
+
+	// lower bound of each segment, -inf for the first one and +inf for unused ones
+	std::array<float, max_points> segment_start{};
+	// y = slope * x + offset within each segment
+	std::array<float, max_points> slope{};
+	std::array<float, max_points> offset{};
+
+	void update_segments();
+
+public:
+	CalibrationTable() { update_segments(); }
+
+	// x must be strictly increasing, returns false otherwise
+	bool set(const float *x, const float *y, size_t len);
+
+	void clear();
+
+	size_t size() const { return count; }
+	float get_x(const size_t i) const { return x_points[i]; }
+	float get_y(const size_t i) const { return y_points[i]; }
+
+	// runs on every sample: fixed number of compares without data dependent branches, then one multiply-add
+	float apply(const float x) const
+	{
+		size_t segment{0};
+		for (size_t step = max_points / 2; step > 0; step /= 2)
+			segment += segment_start[segment + step] <= x ? step : 0;
+		return slope[segment] * x + offset[segment];
+	}
+};
+
+namespace calibration
+{
+	// read the tables of all channels from NVS
+	void load();
+
+	// write the tables of all channels to NVS
+	void store();
+} // namespace calibration
@@ -2,64 +2,372 @@
 // Created by TGA on 22.06.25.
 //
 
+#include <Arduino.h>
 #include <M5Unified.hpp>
+#include <Wire.h>
+#include <algorithm>
+#include <utility>
 
 #include "channel.hpp"
+#include "event_log.hpp"
 #include "main.hpp"
 
-std::array<Channel, 2> channels{{{MODULE_POWER_ADDR, 0}, {MODULE_POWER_ADDR + 1, 120}}};
+template<size_t... I>
+std::array<Channel, sizeof...(I)> make_channels(std::index_sequence<I...>)
+{
+	return {Channel{I, pps_addresses[I]}...};
+}
+
+std::array<Channel, channel_count> channels{make_channels(std::make_index_sequence<channel_count>{})};
+
+void scan_channels()
+{
+	Wire.begin(M5.In_I2C.getSDA(), M5.In_I2C.getSCL(), 100000U);
+
+	std::array<bool, pps_addresses.size()> found{};
+	for (size_t i = 0; i < pps_addresses.size(); i++)
+	{
+		Wire.beginTransmission(pps_addresses[i]);
+		found[i] = Wire.endTransmission() == 0;
+	}
+
+	// discovered modules first, remaining channels wait for a module on a free address
+	size_t next{0};
+	for (size_t i = 0; i < pps_addresses.size() && next < channels.size(); i++)
+		if (found[i])
+			channels[next++].bind(pps_addresses[i]);
+	for (size_t i = 0; i < pps_addresses.size() && next < channels.size(); i++)
+		if (!found[i])
+			channels[next++].bind(pps_addresses[i]);
+}
+
+void poll_channels()
+{
+	// every channel is sampled on each pass, so statistics and protection run at the full loop rate
+	for (Channel &channel: channels)
+	{
+		channel.update_ramp();
+		channel.loop();
+	}
+}
 
 void Channel::loop()
 {
 	if (!connected)
 	{
+		// a missing module would otherwise block the bus on every poll
+		if (millis() - last_bus_check < reconnect_interval)
+			return;
+		last_bus_check = millis();
+
 		connected = module.begin(&Wire, M5.In_I2C.getSDA(), M5.In_I2C.getSCL(), module_adr, 100000U);
 		if (connected)
 		{
+			event_log::log(event_log::Event::module_connected, index, module_adr);
+			// setpoints first, so an enabled output (e.g. recalled on power on) starts at them
+			write_voltage(voltage_out);
+			write_current(current_out);
 			module.setPowerEnable(enabled);
-			module.setOutputVoltage(voltage_target);
-			module.setOutputCurrent(current_target);
 		}
+		sample_valid = false;
 		return;
 	}
 
+	// the readback functions can't report a missing module, so check its address from time to time
+	if (millis() - last_bus_check >= reconnect_interval)
+	{
+		last_bus_check = millis();
+		Wire.beginTransmission(module_adr);
+		if (Wire.endTransmission() != 0)
+		{
+			event_log::log(event_log::Event::module_disconnected, index, module_adr);
+			connected = false;
+			sample_valid = false;
+			voltage_protection.restart_delay();
+			current_protection.restart_delay();
+			voltage_is = 0;
+			current_is = 0;
+			in_cc_mode = false;
+			return;
+		}
+	}
+
 	if (!enabled)
+	{
+		sample_valid = false;
 		return;
+	}
+
+	const unsigned long sample_start = micros();
+	const float voltage = get_calibration(CalibrationQuantity::voltage_readback).apply(module.getReadbackVoltage());
+	const float current = get_calibration(CalibrationQuantity::current_readback).apply(module.getReadbackCurrent());
+	const bool cc_mode = !module.getMode();
+	if (cc_mode != in_cc_mode)
+		event_log::log(cc_mode ? event_log::Event::cc_mode : event_log::Event::cv_mode, index);
+	in_cc_mode = cc_mode;
+
+	// evaluate both, so both trip flags are latched if both limits are exceeded
+	const bool over_voltage = voltage_protection.check(voltage, sample_start);
+	const bool over_current = current_protection.check(current, sample_start);
+
+	// a fault is seen at most one sample interval late
+	if (sample_valid)
+		max_sample_interval = std::max(max_sample_interval, sample_start - sample_time);
+	max_sample_duration = std::max(max_sample_duration, micros() - sample_start);
+
+	if (over_voltage || over_current)
+		trip(voltage, current);
+
+	update_statistics(voltage, current, sample_start);
+}
+
+bool Protection::check(const float value, const unsigned long time)
+{
+	if (!enabled || value <= level)
+	{
+		exceeded = false;
+		return false;
+	}
+
+	if (!exceeded)
+	{
+		exceeded = true;
+		exceeded_since = time;
+	}
 
-	voltage_is = module.getReadbackVoltage();
-	current_is = module.getReadbackCurrent();
-	in_cc_mode = !module.getMode();
+	if (static_cast<float>(time - exceeded_since) * 1e-6f < delay)
+		return false;
+
+	tripped = true;
+	return true;
+}
+
+void Channel::switch_output(const bool on)
+{
+	if (!connected)
+		return;
+	const unsigned long start = micros();
+	module.setPowerEnable(on);
+	max_switch_time = std::max(max_switch_time, micros() - start);
+}
+
+//a table may correct a setpoint past the range of the module, so the result is limited again
+void Channel::write_voltage(const float voltage)
+{
+	const float corrected{get_calibration(CalibrationQuantity::voltage_setpoint).apply(voltage)};
+	module.setOutputVoltage(std::min(std::max(corrected, 0.0f), max_voltage));
+}
+
+void Channel::write_current(const float current)
+{
+	const float corrected{get_calibration(CalibrationQuantity::current_setpoint).apply(current)};
+	module.setOutputCurrent(std::min(std::max(corrected, 0.0f), max_current));
+}
+
+void Channel::trip(const float voltage, const float current)
+{
+	switch_output(false);
+	enabled = false;
+
+	if (voltage_protection.tripped)
+		event_log::log(event_log::Event::over_voltage, index, static_cast<int16_t>(voltage * 1000));
+	if (current_protection.tripped)
+		event_log::log(event_log::Event::over_current, index, static_cast<int16_t>(current * 1000));
+	event_log::log(event_log::Event::output_off, index);
+
+	// abort a running ramp, a disabled output holds its targets
+	voltage_out = voltage_target;
+	current_out = current_target;
+	write_voltage(voltage_out);
+	write_current(current_out);
+}
+
+//move value towards target by at most step
+float approach(const float value, const float target, const float step)
+{
+	if (target > value)
+		return std::min(value + step, target);
+	return std::max(value - step, target);
+}
+
+void Channel::start_ramp()
+{
+	voltage_ramp_start = voltage_out;
+	current_ramp_start = current_out;
+
+	if (!enabled || voltage_slew <= 0)
+		voltage_out = voltage_target;
+	if (!enabled || current_slew <= 0)
+		current_out = current_target;
+
+	if (connected)
+	{
+		write_voltage(voltage_out);
+		write_current(current_out);
+	}
+	next_ramp_step = micros() + ramp_step_interval;
+}
+
+void Channel::set_voltage_slew(const float slew)
+{
+	voltage_slew = slew;
+	if (voltage_slew <= 0 && voltage_out != voltage_target)
+	{
+		voltage_out = voltage_target;
+		if (connected)
+			write_voltage(voltage_out);
+	}
+}
+
+void Channel::set_current_slew(const float slew)
+{
+	current_slew = slew;
+	if (current_slew <= 0 && current_out != current_target)
+	{
+		current_out = current_target;
+		if (connected)
+			write_current(current_out);
+	}
+}
+
+void Channel::update_ramp()
+{
+	if (!is_ramping())
+		return;
+
+	// without a module there is nothing to ramp, a reconnected module gets the targets
+	if (!connected)
+	{
+		voltage_out = voltage_target;
+		current_out = current_target;
+		return;
+	}
+
+	const unsigned long now = micros();
+	if (static_cast<long>(now - next_ramp_step) < 0)
+		return;
+
+	// evenly spaced steps, a late step catches up on the setpoint but not on the schedule
+	const float dt{static_cast<float>(now - (next_ramp_step - ramp_step_interval)) * 1e-6f};
+	next_ramp_step += ramp_step_interval;
+	if (static_cast<long>(now - next_ramp_step) > 0)
+		next_ramp_step = now + ramp_step_interval;
+
+	if (voltage_out != voltage_target)
+	{
+		voltage_out = approach(voltage_out, voltage_target, voltage_slew * dt);
+		write_voltage(voltage_out);
+	}
+	if (current_out != current_target)
+	{
+		current_out = approach(current_out, current_target, current_slew * dt);
+		write_current(current_out);
+	}
+}
+
+float Channel::get_ramp_progress() const
+{
+	float progress{1.0};
+	if (voltage_out != voltage_target)
+		progress = std::min(progress, (voltage_out - voltage_ramp_start) / (voltage_target - voltage_ramp_start));
+	if (current_out != current_target)
+		progress = std::min(progress, (current_out - current_ramp_start) / (current_target - current_ramp_start));
+	return progress;
+}
+
+float Channel::get_worst_trip_latency() const
+{
+	return static_cast<float>(max_sample_interval + max_sample_duration + max_switch_time) * 1e-6f;
+}
+
+void Channel::update_statistics(const float voltage, const float current, const unsigned long time)
+{
+	// trapezoidal integration over the real interval to the previous sample
+	if (sample_valid)
+	{
+		const double dt = static_cast<double>(time - sample_time) * 1e-6;
+		charge += 0.5 * (current_is + current) * dt;
+		energy += 0.5 * (voltage_is * current_is + voltage * current) * dt;
+		statistics_time += dt;
+	}
+
+	if (statistics_empty)
+	{
+		voltage_min = voltage_max = voltage;
+		current_min = current_max = current;
+		statistics_empty = false;
+	} else
+	{
+		voltage_min = std::min(voltage_min, voltage);
+		voltage_max = std::max(voltage_max, voltage);
+		current_min = std::min(current_min, current);
+		current_max = std::max(current_max, current);
+	}
+
+	voltage_is = voltage;
+	current_is = current;
+	sample_time = time;
+	sample_valid = true;
+}
+
+void Channel::reset_statistics()
+{
+	charge = 0.0;
+	energy = 0.0;
+	statistics_time = 0.0;
+	voltage_min = voltage_max = 0.0;
+	current_min = current_max = 0.0;
+	statistics_empty = true;
+	// the next sample starts a new integration interval
+	sample_valid = false;
 }
 
 void Channel::set_voltage(const float voltage)
 {
 	voltage_target = voltage;
-	if (connected)
-		module.setOutputVoltage(voltage_target);
+	start_ramp();
 }
 
 void Channel::set_current(const float current)
 {
 	current_target = current;
-	if (connected)
-		module.setOutputCurrent(current_target);
+	start_ramp();
 }
 
-void Channel::set_enabled(const bool in)
+bool Channel::set_enabled(const bool in)
 {
-	enabled = in;
-	if (connected)
+	if (in && is_tripped())
+		return false;
+
+	// soft start: ramp up from zero when the output is switched on
+	if (in && !enabled)
 	{
-		module.setPowerEnable(in);
-		module.setOutputVoltage(voltage_target);
-		module.setOutputCurrent(current_target);
+		if (voltage_slew > 0)
+			voltage_out = 0;
+		if (current_slew > 0)
+			current_out = 0;
 	}
+
+	if (in != enabled)
+		event_log::log(in ? event_log::Event::output_on : event_log::Event::output_off, index);
+
+	// setpoints are only changed while the output is off, so aborting a ramp can't cause a spike
+	enabled = in;
+	if (!enabled)
+		switch_output(false);
+	start_ramp();
+	if (enabled)
+		switch_output(true);
 	if (!enabled)
 	{
 		voltage_is = 0;
 		current_is = 0;
 		in_cc_mode = false;
 	}
+	sample_valid = false;
+	voltage_protection.restart_delay();
+	current_protection.restart_delay();
+	return true;
 }
 
 void Channel::set_address(const uint8_t addr)
@@ -69,14 +377,33 @@ void Channel::set_address(const uint8_t addr)
 	connected = false;
 }
 
-void Channel::draw(const char* name) const
+void Channel::bind(const uint8_t addr)
+{
+	module_adr = addr;
+	connected = false;
+	last_bus_check = millis() - reconnect_interval;
+}
+
+void Channel::draw(const char* name, const int y, const int height) const
 {
+	//rows below 50 px have no room for two text lines, so more than four channels are drawn in a single line each
+	if (height < 50)
+	{
+		draw_row(name, y, height);
+		return;
+	}
+
+	//two channels get the large layout, three and four channels are drawn in compact rows
+	const bool compact{height < 100};
+	const int label_y{y + (compact ? 2 : 8)};
+	const int value_y{y + (compact ? height / 2 : 60)};
+
 	//try to connect module if not already connected
 	if (!connected)
 	{
 		canvas.setTextColor(TFT_RED);
 		canvas.setFont(&efontCN_16);
-		canvas.setCursor(30, display_offset + 40);
+		canvas.setCursor(30, compact ? value_y - 8 : y + 40);
 		canvas.print("Module not found");
 		return;
 	}
@@ -84,34 +411,79 @@ void Channel::draw(const char* name) const
 	//channel Label
 	canvas.setTextColor(TFT_YELLOW);
 	canvas.setFont(&efontCN_12);
-	canvas.setCursor(16, display_offset + 8);
+	canvas.setCursor(16, label_y);
 	canvas.print(name);
 
 	//cv/cc mode
-	canvas.setTextColor(in_cc_mode ? TFT_RED : TFT_YELLOW);
-	canvas.setCursor(80, display_offset + 8);
-	if (enabled)
-		canvas.print(in_cc_mode ? "CC" : "CV");
+	canvas.setCursor(80, label_y);
+	draw_mode();
 
 	//power
 	canvas.setTextColor(enabled ? TFT_GREEN : TFT_YELLOW);
-	canvas.setCursor(170, display_offset + 8);
+	canvas.setCursor(170, label_y);
 	const float power = enabled ? voltage_is * current_is : voltage_target * current_target;
 	canvas.printf("%3.1f W", power);
 
 	//voltage measurement/setting
 	canvas.setFont(&efontCN_16);
-	canvas.setCursor(20, display_offset + 60);
+	canvas.setCursor(20, value_y);
 	canvas.printf("%4.2f V", enabled ? voltage_is : voltage_target);
 
 	//current measurement/setting
-	canvas.setCursor(170, display_offset + 60);
+	canvas.setCursor(170, value_y);
 	canvas.printf("%4.1f mA", (enabled ? current_is : current_target) * 1000);
 }
 
+void Channel::draw_row(const char* name, const int y, const int height) const
+{
+	//label, mode, voltage and current side by side, the power is left out
+	canvas.setFont(&efontCN_12);
+	const int text_y{y + (height - canvas.fontHeight()) / 2};
+
+	canvas.setTextColor(TFT_YELLOW);
+	canvas.setCursor(4, text_y);
+	canvas.print(name);
+
+	if (!connected)
+	{
+		canvas.setTextColor(TFT_RED);
+		canvas.setCursor(64, text_y);
+		canvas.print("Module not found");
+		return;
+	}
+
+	canvas.setCursor(56, text_y);
+	draw_mode();
+
+	canvas.setTextColor(enabled ? TFT_GREEN : TFT_YELLOW);
+	canvas.setCursor(104, text_y);
+	canvas.printf("%5.2fV", enabled ? voltage_is : voltage_target);
+
+	canvas.setCursor(200, text_y);
+	canvas.printf("%6.1fmA", (enabled ? current_is : current_target) * 1000);
+}
+
+//cv/cc mode, or the tripped protection of a disabled output
+void Channel::draw_mode() const
+{
+	canvas.setTextColor(in_cc_mode ? TFT_RED : TFT_YELLOW);
+	if (enabled)
+		canvas.print(in_cc_mode ? "CC" : "CV");
+	else if (is_tripped())
+	{
+		canvas.setTextColor(TFT_RED);
+		canvas.print(voltage_protection.tripped ? "OVP" : "OCP");
+	}
+}
+
 void Channel::reset()
 {
+	voltage_protection = Protection{max_voltage};
+	current_protection = Protection{max_current};
+	voltage_slew = 0;
+	current_slew = 0;
 	set_enabled(false);
 	set_voltage(0);
 	set_current(0);
+	reset_statistics();
 }
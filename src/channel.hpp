@@ -5,36 +5,139 @@
 #pragma once
 
 #include <M5ModulePPS.h>
+#include <array>
+
+#include "calibration.hpp"
+
+// number of output channels, can be set with a build flag
+#ifndef CHANNEL_COUNT
+#define CHANNEL_COUNT 2
+#endif
+
+// addresses searched for PPS modules, skipping the touch controller at 0x38 on the internal bus
+constexpr std::array<uint8_t, 8> pps_addresses{
+	MODULE_POWER_ADDR, MODULE_POWER_ADDR + 1, MODULE_POWER_ADDR + 2, 0x39, 0x3A, 0x3B, 0x3C, 0x3D
+};
+
+constexpr size_t channel_count{CHANNEL_COUNT};
+static_assert(channel_count >= 1 && channel_count <= pps_addresses.size(), "unsupported CHANNEL_COUNT");
+
+//over voltage / over current protection of one quantity
+struct Protection
+{
+	bool enabled{false};
+	float level;
+	//time in s the value has to stay above level before the output is switched off
+	float delay{0.0};
+	//latched until cleared
+	bool tripped{false};
+
+	bool exceeded{false};
+	unsigned long exceeded_since{};
+
+	explicit Protection(const float level): level(level) {}
+
+	//evaluate a new sample taken at time (µs), returns true if the output has to be switched off
+	bool check(float value, unsigned long time);
+
+	void clear()
+	{
+		tripped = false;
+		exceeded = false;
+	}
+
+	//restart the delay, a level exceeded before the output was off or the module was missing doesn't count
+	void restart_delay() { exceeded = false; }
+};
 
 class Channel
 {
+	// time in ms between connection attempts to a missing module or checks that a connected module is still there
+	static constexpr unsigned long reconnect_interval{500};
+
+	uint8_t index;
 	uint8_t module_adr;
 	bool connected{false};
 	M5ModulePPS module{};
-	uint8_t display_offset;
+	unsigned long last_bus_check{};
 
 	//settings
 	float voltage_target{0.0};
 	float current_target{0.1};
 	bool enabled{false};
+	//slew rates in V/s and A/s, 0 applies a new target immediately
+	float voltage_slew{0.0};
+	float current_slew{0.0};
+
+	//setpoints sent to the module, follow the targets with the slew rate while the output is enabled
+	float voltage_out{0.0};
+	float current_out{0.1};
+	float voltage_ramp_start{0.0};
+	float current_ramp_start{0.1};
+	unsigned long next_ramp_step{};
 
 	//measurements
 	float voltage_is{0.0};
 	float current_is{0.0};
 	bool in_cc_mode{false};
 
+	//statistics since last reset
+	unsigned long sample_time{};
+	bool sample_valid{false};
+	double charge{0.0};
+	double energy{0.0};
+	double statistics_time{0.0};
+	float voltage_min{0.0};
+	float voltage_max{0.0};
+	float current_min{0.0};
+	float current_max{0.0};
+	bool statistics_empty{true};
+
+	//integrate charge and energy, update min/max with a new sample
+	void update_statistics(float voltage, float current, unsigned long time);
+
+	//protection and its timing in µs
+	Protection voltage_protection{max_voltage};
+	Protection current_protection{max_current};
+	unsigned long max_sample_interval{};
+	unsigned long max_sample_duration{};
+	unsigned long max_switch_time{};
+
+	std::array<CalibrationTable, calibration_quantity_count> calibration{};
+
+	//send a setpoint to the module through the setpoint calibration
+	void write_voltage(float voltage);
+	void write_current(float current);
+
+	//switch the module output and record the time it takes
+	void switch_output(bool on);
+
+	//switch the output off after a protection tripped at the sampled voltage and current
+	void trip(float voltage, float current);
+
+	//start ramping from the current setpoints, or apply the targets directly if no ramp is needed
+	void start_ramp();
+
+	//single line layout for rows too small for draw()
+	void draw_row(const char* name, int y, int height) const;
+	void draw_mode() const;
+
 public:
 	static constexpr float max_voltage{12.0};
 	static constexpr float max_current{5.0};
+	//time in µs between two setpoint updates of a ramp
+	static constexpr unsigned long ramp_step_interval{10000};
 
-	Channel(const uint8_t module_adr, const uint8_t display_offset): module_adr(module_adr),
-	                                                                 display_offset(display_offset) {}
+	Channel(const uint8_t index, const uint8_t module_adr): index(index), module_adr(module_adr) {}
 
 	//refresh measurement data
 	void loop();
 
-	//refresh gui output
-	void draw(const char* name) const;
+	//send the next ramp setpoints if a step is due, call as often as possible
+	void update_ramp();
+
+	//refresh gui output in the area from y to y + height
+	void draw(const char* name, int y, int height) const;
 
 	void set_voltage(float voltage);
 
@@ -44,12 +147,32 @@ public:
 
 	float get_current() const { return current_target; }
 
-	void set_enabled(bool in);
+	//a slew rate of 0 ends a running ramp at its target
+	void set_voltage_slew(float slew);
+
+	float get_voltage_slew() const { return voltage_slew; }
+
+	void set_current_slew(float slew);
+
+	float get_current_slew() const { return current_slew; }
+
+	bool is_ramping() const { return voltage_out != voltage_target || current_out != current_target; }
+
+	//progress of the running ramp from 0 to 1, 1 if no ramp is running
+	float get_ramp_progress() const;
+
+	//returns false if the output can't be enabled because a protection is tripped
+	bool set_enabled(bool in);
 
 	bool is_enabled() const { return enabled; }
 
 	void set_address(uint8_t addr);
 
+	//use the module at addr for this channel
+	void bind(uint8_t addr);
+
+	uint8_t get_address() const { return module_adr; }
+
 	void reset();
 
 	float get_current_measurement() const { return current_is; }
@@ -57,6 +180,46 @@ public:
 	bool is_in_cc_mode() const { return in_cc_mode; }
 
 	bool is_connected() const { return connected; }
+
+	void reset_statistics();
+
+	//charge in Ah since last reset
+	double get_charge() const { return charge / 3600.0; }
+	//energy in Wh since last reset
+	double get_energy() const { return energy / 3600.0; }
+	//integration time in s since last reset
+	double get_statistics_time() const { return statistics_time; }
+
+	float get_voltage_min() const { return voltage_min; }
+	float get_voltage_max() const { return voltage_max; }
+	float get_current_min() const { return current_min; }
+	float get_current_max() const { return current_max; }
+
+	Protection &get_voltage_protection() { return voltage_protection; }
+	const Protection &get_voltage_protection() const { return voltage_protection; }
+	Protection &get_current_protection() { return current_protection; }
+	const Protection &get_current_protection() const { return current_protection; }
+
+	bool is_tripped() const { return voltage_protection.tripped || current_protection.tripped; }
+
+	CalibrationTable &get_calibration(CalibrationQuantity quantity)
+	{
+		return calibration[static_cast<size_t>(quantity)];
+	}
+
+	const CalibrationTable &get_calibration(CalibrationQuantity quantity) const
+	{
+		return calibration[static_cast<size_t>(quantity)];
+	}
+
+	//worst case time in s from a fault at the output to the output being switched off, without protection delay
+	float get_worst_trip_latency() const;
 };
 
-extern std::array<Channel, 2> channels;
+extern std::array<Channel, channel_count> channels;
+
+//search the bus for PPS modules and bind them to the channels in address order
+void scan_channels();
+
+//step the ramps and sample all channels
+void poll_channels();
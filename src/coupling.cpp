@@ -0,0 +1,151 @@
+//
+// Created on 19.10.26.
+//
+
+#include "coupling.hpp"
+
+#include <Arduino.h>
+#include <algorithm>
+#include <cmath>
+
+#include "channel.hpp"
+
+namespace coupling
+{
+	// time in ms between two current balancing steps, long enough for the modules to settle
+	constexpr unsigned long balance_interval{50};
+	// voltage trim in V per A of current difference and balancing step
+	constexpr float balance_gain{0.01};
+	// largest voltage difference in V the balancing may apply
+	constexpr float max_trim{0.05};
+	// smallest setpoint change in V worth a write to the module
+	constexpr float min_setpoint_change{0.0005};
+
+	PairMode pair_mode{PairMode::off};
+	bool tracking{false};
+
+	// added to the voltage of channel 2 in parallel mode
+	float parallel_trim{0.0};
+	unsigned long last_balance{};
+
+	bool set_pair_mode(const PairMode mode)
+	{
+		if (channel_count < 2)
+			return mode == PairMode::off;
+		pair_mode = mode;
+		parallel_trim = 0.0;
+		return true;
+	}
+
+	PairMode get_pair_mode()
+	{
+		return pair_mode;
+	}
+
+	bool set_tracking(const bool in)
+	{
+		if (channel_count < 2)
+			return !in;
+		tracking = in;
+		return true;
+	}
+
+	bool is_tracking()
+	{
+		return tracking;
+	}
+
+	bool is_voltage_coupled(const size_t channel)
+	{
+		return channel == 1 && (tracking || pair_mode != PairMode::off);
+	}
+
+	bool is_output_coupled(const size_t channel)
+	{
+		return channel == 1 && pair_mode != PairMode::off;
+	}
+
+	// move the trim so the channel delivering less current takes over more of the load
+	void balance_current(const Channel &leader, const Channel &follower)
+	{
+		if (millis() - last_balance < balance_interval)
+			return;
+		last_balance = millis();
+
+		if (!leader.is_enabled() || !follower.is_enabled() || !leader.is_connected() || !follower.is_connected())
+		{
+			parallel_trim = 0.0;
+			return;
+		}
+
+		const float difference{leader.get_current_measurement() - follower.get_current_measurement()};
+		parallel_trim = std::min(std::max(parallel_trim + balance_gain * difference, -max_trim), max_trim);
+	}
+
+	void loop()
+	{
+		if (channel_count < 2 || (pair_mode == PairMode::off && !tracking))
+			return;
+
+		Channel &leader = channels[0];
+		Channel &follower = channels[1];
+
+		if (pair_mode != PairMode::off)
+		{
+			// one tripped module switches off the pair
+			if (follower.is_tripped() && leader.is_enabled())
+				leader.set_enabled(false);
+
+			follower.set_current_slew(leader.get_current_slew());
+			if (follower.get_current() != leader.get_current())
+				follower.set_current(leader.get_current());
+			if (follower.is_enabled() != leader.is_enabled())
+				follower.set_enabled(leader.is_enabled());
+		}
+
+		if (pair_mode == PairMode::parallel)
+			balance_current(leader, follower);
+
+		follower.set_voltage_slew(leader.get_voltage_slew());
+
+		const bool trimmed{pair_mode == PairMode::parallel};
+		const float trim{trimmed ? parallel_trim : 0.0f};
+		float voltage{std::max(leader.get_voltage() + trim, 0.0f)};
+		if (voltage > Channel::max_voltage)
+			voltage = Channel::max_voltage;
+		// small trim changes are collected until they are worth a write to the module
+		if (std::fabs(follower.get_voltage() - voltage) > (trimmed ? min_setpoint_change : 0.0f))
+			follower.set_voltage(voltage);
+	}
+
+	float get_voltage_measurement(const size_t channel)
+	{
+		const float voltage{channels[channel].get_voltage_measurement()};
+		if (channel != 0 || channel_count < 2)
+			return voltage;
+		if (pair_mode == PairMode::series)
+			return voltage + channels[1].get_voltage_measurement();
+		if (pair_mode == PairMode::parallel)
+			return 0.5f * (voltage + channels[1].get_voltage_measurement());
+		return voltage;
+	}
+
+	float get_current_measurement(const size_t channel)
+	{
+		const float current{channels[channel].get_current_measurement()};
+		if (channel != 0 || channel_count < 2)
+			return current;
+		if (pair_mode == PairMode::series)
+			return 0.5f * (current + channels[1].get_current_measurement());
+		if (pair_mode == PairMode::parallel)
+			return current + channels[1].get_current_measurement();
+		return current;
+	}
+
+	void reset()
+	{
+		pair_mode = PairMode::off;
+		tracking = false;
+		parallel_trim = 0.0;
+	}
+} // namespace coupling
@@ -0,0 +1,47 @@
+//
+// Created on 19.10.26.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// channel 2 following channel 1, for ±V rails or doubled voltage or current
+namespace coupling
+{
+	enum class PairMode : uint8_t
+	{
+		off,
+		// outputs wired in series: channel 2 follows voltage, current and output state of channel 1
+		series,
+		// outputs wired in parallel: like series, channel 2's voltage is trimmed so both deliver the same current
+		parallel,
+	};
+
+	// returns false if there is no second channel
+	bool set_pair_mode(PairMode mode);
+
+	PairMode get_pair_mode();
+
+	// channel 2 follows the voltage of channel 1, returns false if there is no second channel
+	bool set_tracking(bool in);
+
+	bool is_tracking();
+
+	// the voltage setting of the channel is controlled by another one
+	bool is_voltage_coupled(size_t channel);
+
+	// current setting and output state of the channel are controlled by another one
+	bool is_output_coupled(size_t channel);
+
+	// propagate the settings of channel 1, call after polling the channels
+	void loop();
+
+	// measurement of the channel, the combined one of the pair for channel 1 in a pair mode
+	float get_voltage_measurement(size_t channel);
+
+	float get_current_measurement(size_t channel);
+
+	void reset();
+} // namespace coupling
@@ -0,0 +1,221 @@
+//
+// Created on 19.10.26.
+//
+
+#include "datalogger.hpp"
+
+#include <Arduino.h>
+#include <M5Unified.hpp>
+#include <SD.h>
+#include <SPI.h>
+#include <array>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "channel.hpp"
+#include "event_log.hpp"
+#include "log_recorder.hpp"
+
+namespace datalogger
+{
+	constexpr uint32_t sd_frequency{25000000};
+	// time in ms start() waits for the writer to release the bus
+	constexpr uint32_t start_timeout{100};
+
+	SemaphoreHandle_t bus_mutex{};
+	TaskHandle_t writer_handle{};
+	bool card_mounted{false};
+	File file;
+
+	uint32_t rate{default_rate};
+	unsigned long next_record_time{};
+	char file_name[16]{};
+
+	bool lock_bus(const TickType_t timeout)
+	{
+		return xSemaphoreTake(bus_mutex, timeout) == pdTRUE;
+	}
+
+	bool try_lock_bus()
+	{
+		return xSemaphoreTake(bus_mutex, 0) == pdTRUE;
+	}
+
+	void unlock_bus()
+	{
+		xSemaphoreGive(bus_mutex);
+	}
+
+	bool mount_card()
+	{
+		if (!card_mounted)
+		{
+			SPI.begin(M5.getPin(m5::pin_name_t::sd_spi_sclk), M5.getPin(m5::pin_name_t::sd_spi_cipo),
+			          M5.getPin(m5::pin_name_t::sd_spi_copi), M5.getPin(m5::pin_name_t::sd_spi_cs));
+			card_mounted = SD.begin(M5.getPin(m5::pin_name_t::sd_spi_cs), SPI, sd_frequency);
+		}
+		return card_mounted;
+	}
+
+	bool file_exists(const char *name)
+	{
+		return SD.exists(name);
+	}
+
+	bool open_file(const char *name)
+	{
+		file = SD.open(name, FILE_WRITE);
+		return file;
+	}
+
+	// flushed after every buffer, so a power loss costs at most two buffers
+	bool write_file(const uint8_t *data, const size_t len)
+	{
+		const bool ok{file.write(data, len) == len};
+		file.flush();
+		return ok;
+	}
+
+	void close_file()
+	{
+		file.close();
+	}
+
+	void notify_writer()
+	{
+		xTaskNotifyGive(writer_handle);
+	}
+
+	constexpr FileOps card_files{file_exists, open_file, write_file, close_file};
+	Recorder recorder{card_files, channel_count, notify_writer};
+
+	// the recorder calls the file functions with the bus held
+	void writer_task(void *)
+	{
+		for (;;)
+		{
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			lock_bus(portMAX_DELAY);
+			recorder.write_pending();
+			unlock_bus();
+		}
+	}
+
+	void begin()
+	{
+		bus_mutex = xSemaphoreCreateMutex();
+		// the arduino loop runs on core 1
+		xTaskCreatePinnedToCore(writer_task, "datalogger", 4096, nullptr, 1, &writer_handle, 0);
+	}
+
+	StartResult start()
+	{
+		if (recorder.is_running())
+			return StartResult::started;
+
+		// runs on the command path, so a slow card write must not block it
+		if (!lock_bus(pdMS_TO_TICKS(start_timeout)))
+			return StartResult::busy;
+		const bool started{mount_card() && recorder.start()};
+		unlock_bus();
+		if (!started)
+			return StartResult::no_card;
+
+		next_record_time = micros();
+		event_log::log(event_log::Event::datalogger_start, event_log::no_channel,
+		               static_cast<int16_t>(recorder.get_file_index()));
+		return StartResult::started;
+	}
+
+	void stop()
+	{
+		if (!recorder.is_running())
+			return;
+		recorder.stop();
+		event_log::log(event_log::Event::datalogger_stop, event_log::no_channel,
+		               static_cast<int16_t>(recorder.get_file_index()));
+	}
+
+	bool is_running()
+	{
+		return recorder.is_running();
+	}
+
+	bool set_rate(const uint32_t in)
+	{
+		if (in < 1 || in > max_rate)
+			return false;
+		rate = in;
+		return true;
+	}
+
+	uint32_t get_rate()
+	{
+		return rate;
+	}
+
+	void set_rotate_size(const uint32_t bytes)
+	{
+		recorder.set_rotate_size(bytes);
+	}
+
+	uint32_t get_rotate_size()
+	{
+		return recorder.get_rotate_size();
+	}
+
+	const char *get_file_name()
+	{
+		const uint32_t index{recorder.get_file_index()};
+		if (index)
+			make_file_name(index, file_name);
+		return file_name;
+	}
+
+	uint32_t get_dropped_records()
+	{
+		return recorder.get_dropped_records();
+	}
+
+	void loop()
+	{
+		switch (recorder.loop())
+		{
+			case Recorder::LoopResult::idle:
+				return;
+			case Recorder::LoopResult::failed:
+				event_log::log(event_log::Event::datalogger_error, event_log::no_channel,
+				               static_cast<int16_t>(recorder.get_file_index()));
+				return;
+			case Recorder::LoopResult::recording:
+				break;
+		}
+
+		const unsigned long now = micros();
+		if (static_cast<long>(now - next_record_time) < 0)
+			return;
+
+		// keep the record grid, but don't try to catch up after a long stall
+		next_record_time += 1000000UL / rate;
+		if (static_cast<long>(now - next_record_time) > 0)
+			next_record_time = now;
+
+		std::array<ChannelSample, channel_count> samples;
+		for (size_t i{0}; i < channel_count; i++)
+		{
+			const Channel &channel = channels[i];
+			samples[i] = {channel.get_voltage_measurement(), channel.get_current_measurement(), channel.is_enabled(),
+			              channel.is_in_cc_mode(), channel.is_connected()};
+		}
+		recorder.add(static_cast<uint64_t>(esp_timer_get_time()), samples.data());
+	}
+
+	void reset()
+	{
+		stop();
+		rate = default_rate;
+		recorder.set_rotate_size(default_rotate_size);
+	}
+} // namespace datalogger
@@ -0,0 +1,78 @@
+//
+// Created on 19.10.26.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// recording of all channels to files on the SD card
+//
+// file layout (little endian):
+//   header:
+//     char[4] magic            "PSUL"
+//     uint8   version          2
+//     uint8   channel count
+//     uint16  record size      bytes per record
+//   records:
+//     uint64  timestamp        µs since boot, continues across rotated files
+//     per channel:
+//       float voltage [V], float current [A], uint8 flags (bit0 enabled, bit1 cc mode, bit2 connected)
+//
+// Records are collected in one of two buffers while a task on the other core writes the full one to the card,
+// so a slow card never blocks the poll loop. Records that find both buffers busy are dropped and counted.
+namespace datalogger
+{
+	constexpr uint32_t max_rate{1000};
+	constexpr uint32_t default_rate{10};
+	// start a new file after this many bytes, 0 never rotates
+	constexpr uint32_t default_rotate_size{0};
+
+	// create the writer task, call once from setup()
+	void begin();
+
+	enum class StartResult : uint8_t
+	{
+		started,
+		// no card, or no free file name left
+		no_card,
+		// the writer didn't release the bus in time
+		busy,
+	};
+
+	// open the next free file and start recording
+	StartResult start();
+
+	// write the remaining records and close the file
+	void stop();
+
+	bool is_running();
+
+	// records per second, returns false if out of range
+	bool set_rate(uint32_t rate);
+
+	uint32_t get_rate();
+
+	void set_rotate_size(uint32_t bytes);
+
+	uint32_t get_rotate_size();
+
+	// name of the file that is or was last recorded to, empty before the first start
+	const char *get_file_name();
+
+	// records dropped since the last start because the card could not keep up
+	uint32_t get_dropped_records();
+
+	// record a sample if one is due, call after polling the channels
+	void loop();
+
+	// stop recording and restore the default settings
+	void reset();
+
+	// the card shares the SPI bus with the display, the bus must be held to push the canvas
+	// never waits, returns false if the writer is using the bus
+	bool try_lock_bus();
+
+	void unlock_bus();
+} // namespace datalogger
@@ -0,0 +1,49 @@
+//
+// Created on 19.10.26.
+//
+
+#include "event_log.hpp"
+
+#include <algorithm>
+#include <esp_timer.h>
+
+namespace event_log
+{
+	std::array<Record, capacity> records;
+	// index of the next record, wraps around
+	uint32_t head{};
+
+	void log(const Event event, const uint8_t channel, const int16_t data)
+	{
+		records[head++ & (capacity - 1)] = {static_cast<uint64_t>(esp_timer_get_time()), data, event, channel};
+	}
+
+	size_t size()
+	{
+		return head < capacity ? head : capacity;
+	}
+
+	uint32_t total()
+	{
+		return head;
+	}
+
+	const Record &get(const size_t index)
+	{
+		return records[(head - size() + index) & (capacity - 1)];
+	}
+
+	void get_parts(const Record *&first, size_t &first_len, const Record *&second, size_t &second_len)
+	{
+		const size_t start = (head - size()) & (capacity - 1);
+		first = records.data() + start;
+		first_len = std::min(size(), capacity - start);
+		second = records.data();
+		second_len = size() - first_len;
+	}
+
+	void clear()
+	{
+		head = 0;
+	}
+} // namespace event_log
@@ -0,0 +1,65 @@
+//
+// Created on 19.10.26.
+//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// fixed size log of state changes and errors, the oldest records are overwritten
+namespace event_log
+{
+	// codes are part of the SYSTem:LOG? output, only append new ones
+	enum class Event : uint8_t
+	{
+		boot = 0,
+		scpi_error = 1, // data: error number
+		module_connected = 2, // data: i2c address
+		module_disconnected = 3, // data: i2c address
+		output_on = 4,
+		output_off = 5,
+		cc_mode = 6,
+		cv_mode = 7,
+		over_voltage = 8, // data: voltage in mV
+		over_current = 9, // data: current in mA
+		datalogger_start = 10, // data: file number
+		datalogger_stop = 11, // data: file number
+		datalogger_error = 12, // data: file number
+	};
+
+	constexpr uint8_t no_channel{0xFF};
+
+	// little endian, 12 bytes in the binary SYSTem:LOG? output
+	struct __attribute__((packed)) Record
+	{
+		// µs since boot
+		uint64_t time;
+		int16_t data;
+		Event event;
+		// channel index starting at 0 or no_channel
+		uint8_t channel;
+	};
+
+	static_assert(sizeof(Record) == 12, "unexpected record size");
+
+	constexpr size_t capacity{256};
+	static_assert((capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+	void log(Event event, uint8_t channel = no_channel, int16_t data = 0);
+
+	// number of records currently stored
+	size_t size();
+
+	// number of records logged since the last clear, including overwritten ones
+	uint32_t total();
+
+	// record by age, 0 is the oldest stored record
+	const Record &get(size_t index);
+
+	// the stored records as up to two contiguous parts, oldest first
+	void get_parts(const Record *&first, size_t &first_len, const Record *&second, size_t &second_len);
+
+	void clear();
+} // namespace event_log
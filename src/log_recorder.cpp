@@ -0,0 +1,223 @@
+//
+// Created on 19.10.26.
+//
+
+#include "log_recorder.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+namespace datalogger
+{
+	namespace
+	{
+		template<typename T>
+		size_t put(uint8_t *buffer, const size_t pos, const T value)
+		{
+			memcpy(buffer + pos, &value, sizeof(T));
+			return pos + sizeof(T);
+		}
+	} // namespace
+
+	void make_file_name(const uint32_t index, char (&name)[16])
+	{
+		snprintf(name, sizeof name, "/LOG%04u.BIN", static_cast<unsigned>(index));
+	}
+
+	Recorder::Recorder(const FileOps &files, const size_t channel_count, void (*const notify)())
+		: files{files}, channel_count{channel_count}, record_size{sizeof(uint64_t) + channel_count * channel_data_size},
+		  notify{notify}
+	{
+	}
+
+	bool Recorder::start()
+	{
+		if (running)
+			return true;
+
+		// continue after the files already on the card
+		const uint32_t next{find_free_index(file_index + 1)};
+		if (!next)
+			return false;
+
+		file_index = next;
+		// the records of a stopped file may still wait in the active buffer
+		if (stopping)
+			next_first_index = next;
+		else
+			buffers[active].first_index = next;
+		file_bytes = header_size;
+		dropped_records = 0;
+		write_failed = false;
+		running = true;
+		return true;
+	}
+
+	void Recorder::stop()
+	{
+		if (!running)
+			return;
+		running = false;
+		stopping = true;
+	}
+
+	bool Recorder::is_running() const
+	{
+		return running;
+	}
+
+	void Recorder::set_rotate_size(const uint32_t bytes)
+	{
+		rotate_size = bytes;
+	}
+
+	uint32_t Recorder::get_rotate_size() const
+	{
+		return rotate_size;
+	}
+
+	uint32_t Recorder::get_file_index() const
+	{
+		return file_index;
+	}
+
+	uint32_t Recorder::get_dropped_records() const
+	{
+		return dropped_records;
+	}
+
+	size_t Recorder::get_record_size() const
+	{
+		return record_size;
+	}
+
+	uint32_t Recorder::find_free_index(uint32_t index) const
+	{
+		char name[16];
+		for (; index <= max_file_index; index++)
+		{
+			make_file_name(index, name);
+			if (!files.exists(name))
+				return index;
+		}
+		return 0;
+	}
+
+	// pass the active buffer to the writer and continue with the other one, returns false if the writer is busy
+	bool Recorder::hand_off(const bool close)
+	{
+		if (pending >= 0)
+			return false;
+
+		buffers[active].close = close;
+		pending = static_cast<int8_t>(active);
+		active ^= 1;
+		buffers[active].len = 0;
+		buffers[active].first_index = next_first_index;
+		next_first_index = 0;
+		notify();
+		return true;
+	}
+
+	Recorder::LoopResult Recorder::loop()
+	{
+		if (write_failed.exchange(false) && (running || stopping))
+		{
+			running = false;
+			stopping = false;
+			buffers[active].len = 0;
+			return LoopResult::failed;
+		}
+
+		// the records of a stopped file go out before those of a new one
+		if (stopping)
+		{
+			if (!hand_off(true))
+				return LoopResult::idle;
+			stopping = false;
+		}
+
+		return running ? LoopResult::recording : LoopResult::idle;
+	}
+
+	void Recorder::add(const uint64_t timestamp, const ChannelSample *samples)
+	{
+		if (rotate_size && file_bytes + record_size > rotate_size && file_bytes > header_size)
+		{
+			if (!hand_off(true))
+			{
+				dropped_records++;
+				return;
+			}
+			file_bytes = header_size;
+		}
+
+		if (buffers[active].len + record_size > buffer_size && !hand_off(false))
+		{
+			dropped_records++;
+			return;
+		}
+
+		Buffer &buffer = buffers[active];
+		size_t pos{buffer.len};
+		pos = put(buffer.data.data(), pos, timestamp);
+		for (size_t i{0}; i < channel_count; i++)
+		{
+			const ChannelSample &sample = samples[i];
+			pos = put(buffer.data.data(), pos, sample.voltage);
+			pos = put(buffer.data.data(), pos, sample.current);
+			buffer.data[pos++] = sample.enabled | sample.cc_mode << 1 | sample.connected << 2;
+		}
+		buffer.len = pos;
+		file_bytes += record_size;
+	}
+
+	// existing files are never overwritten, so a rotation that finds no free name left fails
+	bool Recorder::open_next_file(const uint32_t first_index)
+	{
+		const uint32_t next{find_free_index(first_index ? first_index : file_index + 1)};
+		char name[16];
+		make_file_name(next, name);
+		if (!next || !files.open(name))
+			return false;
+
+		file_index = next;
+		file_open = true;
+		return write_header();
+	}
+
+	bool Recorder::write_header()
+	{
+		std::array<uint8_t, header_size> header;
+		memcpy(header.data(), magic, sizeof magic);
+		size_t pos{sizeof magic};
+		header[pos++] = version;
+		header[pos++] = static_cast<uint8_t>(channel_count);
+		put(header.data(), pos, static_cast<uint16_t>(record_size));
+		return files.write(header.data(), header.size());
+	}
+
+	// files are opened with their first data and closed when the buffer says so
+	void Recorder::write_pending()
+	{
+		const int8_t index{pending};
+		if (index < 0)
+			return;
+
+		const Buffer &buffer = buffers[index];
+		bool ok{true};
+		if (!file_open && buffer.len)
+			ok = open_next_file(buffer.first_index);
+		if (ok && buffer.len)
+			ok = files.write(buffer.data.data(), buffer.len);
+		if (file_open && (buffer.close || !ok))
+		{
+			files.close();
+			file_open = false;
+		}
+
+		if (!ok)
+			write_failed = true;
+		pending = -1;
+	}
+} // namespace datalogger
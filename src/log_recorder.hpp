@@ -0,0 +1,135 @@
+//
+// Created on 19.10.26.
+//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// buffering, record encoding and file rotation of the datalogger (file layout in datalogger.hpp)
+// knows nothing about the card or the writer task, so it also builds on the host for the tests in test/
+namespace datalogger
+{
+	constexpr char magic[4]{'P', 'S', 'U', 'L'};
+	constexpr uint8_t version{2};
+	constexpr size_t header_size{sizeof magic + 1 + 1 + 2};
+	constexpr size_t channel_data_size{2 * sizeof(float) + 1};
+	// a multiple of the 512 byte card sectors
+	constexpr size_t buffer_size{4096};
+	constexpr uint32_t max_file_index{9999};
+
+	// file access of the writer, one file is open at a time
+	struct FileOps
+	{
+		bool (*exists)(const char *name);
+		// creates the file, an existing one is truncated
+		bool (*open)(const char *name);
+		bool (*write)(const uint8_t *data, size_t len);
+		void (*close)();
+	};
+
+	struct ChannelSample
+	{
+		float voltage;
+		float current;
+		bool enabled;
+		bool cc_mode;
+		bool connected;
+	};
+
+	// "/LOG0001.BIN"
+	void make_file_name(uint32_t index, char (&name)[16]);
+
+	// Records are added to the active buffer while the writer may write the other one at the same time. The writer
+	// is woken by notify after every hand-off and calls write_pending(), everything else belongs to the recording
+	// side. Files are only created by the writer, it skips the names already on the card and fails when none is left.
+	class Recorder
+	{
+	public:
+		Recorder(const FileOps &files, size_t channel_count, void (*notify)());
+
+		// searches the next free file name after the last one, returns false if none is left
+		bool start();
+
+		// the remaining records are handed to the writer by the next loop() calls
+		void stop();
+
+		bool is_running() const;
+
+		// start a new file after this many bytes, 0 never rotates
+		void set_rotate_size(uint32_t bytes);
+
+		uint32_t get_rotate_size() const;
+
+		// file that is or was last recorded to, 0 before the first start
+		uint32_t get_file_index() const;
+
+		uint32_t get_dropped_records() const;
+
+		size_t get_record_size() const;
+
+		enum class LoopResult : uint8_t
+		{
+			idle,
+			recording,
+			// the writer failed and the recording was stopped
+			failed,
+		};
+
+		// call before add(), add() is only allowed when recording
+		LoopResult loop();
+
+		// timestamp and one sample per channel, dropped and counted if both buffers are busy
+		void add(uint64_t timestamp, const ChannelSample *samples);
+
+		// writes the handed off buffer, runs in the writer task
+		void write_pending();
+
+	private:
+		struct Buffer
+		{
+			std::array<uint8_t, buffer_size> data;
+			size_t len;
+			// first file index to try when the data needs a new file, 0 continues after the last file
+			uint32_t first_index;
+			// close the file after writing the data
+			bool close;
+		};
+
+		// first index from this one on without a file, 0 if none is left
+		uint32_t find_free_index(uint32_t index) const;
+		bool hand_off(bool close);
+		bool open_next_file(uint32_t first_index);
+		bool write_header();
+
+		const FileOps &files;
+		const size_t channel_count;
+		const size_t record_size;
+		void (*const notify)();
+
+		std::array<Buffer, 2> buffers{};
+		size_t active{0};
+		// buffer handed to the writer, -1 while the writer is idle
+		std::atomic<int8_t> pending{-1};
+		// set by the writer, the recording stops on the next loop
+		std::atomic<bool> write_failed{false};
+		// set by start() and by the writer when it opens a file
+		std::atomic<uint32_t> file_index{0};
+
+		bool running{false};
+		// the remaining records still have to be handed to the writer
+		bool stopping{false};
+		uint32_t rotate_size{0};
+		// size of the current file including the records not yet written
+		uint32_t file_bytes{0};
+		uint32_t dropped_records{0};
+		// first file index of the buffer after the next hand-off
+		uint32_t next_first_index{0};
+
+		// writer side
+		bool file_open{false};
+	};
+} // namespace datalogger
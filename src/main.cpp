@@ -3,10 +3,17 @@
 #include <M5Unified.hpp>
 
 #include "main.hpp"
+#include "calibration.hpp"
 #include "channel.hpp"
+#include "coupling.hpp"
+#include "datalogger.hpp"
+#include "event_log.hpp"
+#include "state_memory.hpp"
+#include "stream.hpp"
 #include "scpi/scpi_client.hpp"
 
-M5GFX display;
+// the display is initialized by M5.begin()
+M5GFX &display{M5.Display};
 M5Canvas canvas(&display);
 
 char serial_num_str[18]{};
@@ -14,18 +21,19 @@ char serial_num_str[18]{};
 bool beeper_active{true};
 char display_text[64]{};
 
+unsigned long ready_time{};
+
 void init_display();
 
 void draw_display_text();
 
 void setup()
 {
-	Serial.begin(115200);
-	Serial.flush();
+	event_log::log(event_log::Event::boot);
+	scpi::begin_serial();
 	Serial.setDebugOutput(false);
 	// uncomment this line for debug output on boot
 	//while (!Serial) {}
-	delay(100);
 
 	//read serial number
 	const uint64_t chip_id = ESP.getEfuseMac();
@@ -36,37 +44,68 @@ void setup()
 
 	M5.begin();
 	init_display();
+	scan_channels();
+	calibration::load();
+	datalogger::begin();
 
 	M5.Speaker.setAllChannelVolume(255);
+
+	state_memory::begin();
+	state_memory::State state;
+	if (state_memory::get_power_on_state(state))
+		apply_state(state);
+
+	ready_time = micros();
 }
 
 void loop()
 {
 	scpi::loop();
 
-	// poll measurements
-	channels[0].loop();
-	channels[1].loop();
+	poll_outputs();
+
+	stream::loop();
+
+	datalogger::loop();
+
+	state_memory::loop();
 
 	//refresh displayed data at 4 HZ
 	//don't use a timer here because scpi commands should take priority over this
+	//the sd card shares the spi bus, if it is being written the refresh is retried on the next loop
 	static unsigned long last_display_refresh{};
-	if (millis() - last_display_refresh > 250)
+	if (millis() - last_display_refresh > 250 && datalogger::try_lock_bus())
 	{
 		canvas.clear();
 		last_display_refresh = millis();
-		//Channel seperator line
-		canvas.drawLine(0, 120, 320, 120, TFT_WHITE);
-		//Channels
-		channels[0].draw("CH1");
-		channels[1].draw("CH2");
+		//Channels with seperator lines
+		const int channel_height{canvas.height() / static_cast<int>(channels.size())};
+		for (size_t i = 0; i < channels.size(); i++)
+		{
+			const int y{static_cast<int>(i) * channel_height};
+			if (i > 0)
+				canvas.drawLine(0, y, 320, y, TFT_WHITE);
+			char name[8];
+			snprintf(name, sizeof name, "CH%u", static_cast<unsigned>(i + 1));
+			channels[i].draw(name, y, channel_height);
+		}
 		//text box
 		draw_display_text();
 
 		canvas.pushSprite(0, 0);
+		datalogger::unlock_bus();
 	}
 }
 
+void poll_outputs()
+{
+	// poll measurements
+	poll_channels();
+
+	// channel 2 follows channel 1 in the same loop
+	coupling::loop();
+}
+
 void beep()
 {
 	if (beeper_active)
@@ -75,7 +114,6 @@ void beep()
 
 void init_display()
 {
-	display.begin();
 	display.setEpdMode(epd_fastest);
 	canvas.setColorDepth(8);
 	canvas.createSprite(display.width(), display.height());
@@ -6,11 +6,18 @@
 
 #include <M5GFX.h>
 
-extern M5GFX display;
+extern M5GFX &display;
 extern M5Canvas canvas;
 
 extern bool beeper_active;
 
 extern char display_text[];
 
+// µs from start until setup() is done and scpi commands are accepted
+extern unsigned long ready_time;
+
 void beep();
+
+// poll the channels, run ramps and protection and couple the channels
+// also called while a command waits for a long transfer, so the outputs are never left unattended
+void poll_outputs();
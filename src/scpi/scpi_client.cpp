@@ -5,7 +5,12 @@
 #include "scpi_client.hpp"
 
 #include <Arduino.h>
+#include <Preferences.h>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cctype>
+#include <event_log.hpp>
 #include <scpi/scpi.h>
 
 namespace scpi
@@ -14,10 +19,94 @@ namespace scpi
 	std::array<scpi_error_t, 17> scpi_error_queue_data;
 	scpi_t scpi_context;
 
+	constexpr uint32_t default_baud_rate{115200};
+	constexpr std::array<uint32_t, 10> supported_baud_rates{
+		9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600, 1500000, 2000000
+	};
+	// time in ms the host has to confirm a new baud rate before the old one is restored
+	constexpr unsigned long baud_confirm_timeout{3000};
+	// 2 MBaud delivers 200 bytes per ms, so this bridges 80 ms without reading, well above the longest loop stall
+	// (pushing the canvas takes about 30 ms)
+	constexpr size_t rx_buffer_size{16384};
+
+	uint32_t baud_rate{default_baud_rate};
+	// requested baud rate, applied after the response of the current command has been sent
+	uint32_t pending_baud_rate{};
+	// last confirmed baud rate, restored if the host does not confirm the new rate
+	uint32_t confirmed_baud_rate{default_baud_rate};
+	bool baud_rate_unconfirmed{false};
+	unsigned long baud_switch_time{};
+
+	// received bytes not yet passed to the parser
+	std::array<char, 64> rx_chunk;
+	size_t rx_pos{};
+	size_t rx_len{};
+
+	enum class InputState : uint8_t
+	{
+		// start of a line, held back in line_buffer until it is clear whether it carries a block for a sink
+		line,
+		// rest of a line that is passed to the parser directly
+		passthrough,
+		// "<n><length>" after a '#'
+		block_header,
+		// payload of a block for a sink
+		block_data,
+		// payload of a block without a sink, passed to the parser unchanged
+		block_passthrough,
+	};
+
+	// the empty block that replaces a streamed one, plus a line end in case of a timeout
+	constexpr char block_placeholder[]{"#10"};
+	constexpr size_t line_reserve{sizeof block_placeholder};
+	// time in ms without a byte after which an incomplete block is given up
+	constexpr unsigned long block_timeout{1000};
+
+	InputState input_state{InputState::line};
+	std::array<char, 64> line_buffer;
+	size_t line_len{};
+	// quote character of an open string in the current line, 0 outside of strings
+	char quote{};
+
+	std::array<char, 10> block_header;
+	size_t block_header_len{};
+	const BlockSink *block_sink{};
+	size_t block_length{};
+	size_t block_received{};
+	BlockStatus block_status{BlockStatus::none};
+	// the current line is already passed to the parser or already streamed a block, so no block can go to a sink
+	bool line_passed{false};
+	bool line_streamed_block{false};
+	unsigned long block_start{};
+	unsigned long last_block_byte{};
+
+	size_t accepted_block_length{};
+	unsigned long accepted_block_duration{};
+
+	// time in ms after which *WAI or *OPC? stop waiting, so input can't be held back forever
+	constexpr unsigned long operation_timeout{60000};
+
+	// *WAI or *OPC? waiting for running operations
+	bool waiting_for_operations{false};
+	unsigned long wait_start{};
+	bool opc_query_pending{false};
+	// *OPC waiting for running operations
+	bool opc_bit_pending{false};
+
+	// status conditions of the last loop, rising edges set the event registers
+	scpi_reg_val_t operation_condition{};
+	scpi_reg_val_t questionable_condition{};
+	// the first loop runs before the channels were polled, so its conditions are taken without events
+	bool status_seeded{false};
+	bool status_notification{false};
+
+	// incremented from the uart event task
+	std::atomic<uint32_t> rx_overrun_count{};
+
 	size_t write_callback(scpi_t *, const char *data, const size_t len)
 	{
-		Serial.print(data);
-		return len;
+		// data is not null terminated and may contain binary blocks
+		return Serial.write(data, len);
 	}
 
 	scpi_result_t flush_callback(scpi_t *)
@@ -28,7 +117,9 @@ namespace scpi
 
 	int error_callback(scpi_t *, const int_fast16_t err)
 	{
-          //todo show on screen
+		if (err)
+			event_log::log(event_log::Event::scpi_error, event_log::no_channel, static_cast<int16_t>(err));
+		//todo show on screen
 		/*if (err)
 		{
 			Serial.print("SCPI Error: ");
@@ -47,6 +138,150 @@ namespace scpi
 		.reset = reset_callback,
 	};
 
+	bool is_supported_baud_rate(const uint32_t baud)
+	{
+		return std::find(supported_baud_rates.begin(), supported_baud_rates.end(), baud) != supported_baud_rates.end();
+	}
+
+	void begin_serial()
+	{
+		Preferences preferences;
+		preferences.begin("serial", true);
+		baud_rate = preferences.getUInt("baud", default_baud_rate);
+		preferences.end();
+
+		if (!is_supported_baud_rate(baud_rate))
+			baud_rate = default_baud_rate;
+		confirmed_baud_rate = baud_rate;
+
+		Serial.setRxBufferSize(rx_buffer_size);
+		Serial.begin(baud_rate);
+		Serial.onReceiveError([](const hardwareSerial_error_t error)
+		{
+			if (error == UART_FIFO_OVF_ERROR || error == UART_BUFFER_FULL_ERROR)
+				++rx_overrun_count;
+		});
+	}
+
+	bool set_baud_rate(const uint32_t baud)
+	{
+		if (!is_supported_baud_rate(baud))
+			return false;
+		pending_baud_rate = baud;
+		return true;
+	}
+
+	void confirm_baud_rate()
+	{
+		if (!baud_rate_unconfirmed)
+			return;
+		baud_rate_unconfirmed = false;
+		confirmed_baud_rate = baud_rate;
+
+		Preferences preferences;
+		preferences.begin("serial", false);
+		preferences.putUInt("baud", baud_rate);
+		preferences.end();
+	}
+
+	uint32_t get_baud_rate()
+	{
+		return baud_rate;
+	}
+
+	void wait_for_operations(const bool answer_query)
+	{
+		waiting_for_operations = true;
+		opc_query_pending = answer_query;
+		wait_start = millis();
+	}
+
+	void set_opc_when_complete()
+	{
+		opc_bit_pending = true;
+	}
+
+	scpi_reg_val_t get_operation_condition()
+	{
+		return operation_condition;
+	}
+
+	scpi_reg_val_t get_questionable_condition()
+	{
+		return questionable_condition;
+	}
+
+	void set_status_notification(const bool in)
+	{
+		status_notification = in;
+	}
+
+	bool get_status_notification()
+	{
+		return status_notification;
+	}
+
+	// set the event bits of a register, returns the new bits that are also enabled
+	scpi_reg_val_t set_events(const scpi_reg_name_t event, const scpi_reg_name_t enable, const scpi_reg_val_t bits)
+	{
+		const scpi_reg_val_t old_events{SCPI_RegGet(&scpi_context, event)};
+		if ((old_events | bits) == old_events)
+			return 0;
+		SCPI_RegSet(&scpi_context, event, old_events | bits);
+		return bits & ~old_events & SCPI_RegGet(&scpi_context, enable);
+	}
+
+	void update_status()
+	{
+		scpi_reg_val_t operation{}, questionable{};
+		status_condition_callback(operation, questionable);
+
+		const scpi_reg_val_t operation_rising = operation & ~operation_condition;
+		const scpi_reg_val_t questionable_rising = questionable & ~questionable_condition;
+		operation_condition = operation;
+		questionable_condition = questionable;
+		if (!status_seeded)
+		{
+			status_seeded = true;
+			return;
+		}
+		if (!operation_rising && !questionable_rising)
+			return;
+
+		const scpi_reg_val_t operation_fired{set_events(SCPI_REG_OPER, SCPI_REG_OPERE, operation_rising)};
+		const scpi_reg_val_t questionable_fired{set_events(SCPI_REG_QUES, SCPI_REG_QUESE, questionable_rising)};
+
+		if (status_notification && (operation_fired || questionable_fired))
+			Serial.printf("!STATUS %u,%u\r\n", operation_fired, questionable_fired);
+	}
+
+	uint32_t get_rx_overrun_count()
+	{
+		return rx_overrun_count;
+	}
+
+	BlockStatus get_streamed_block()
+	{
+		return block_status;
+	}
+
+	BlockStatus take_streamed_block()
+	{
+		const BlockStatus status{block_status};
+		block_status = BlockStatus::none;
+		return status;
+	}
+
+	size_t get_block_length()
+	{
+		return accepted_block_length;
+	}
+
+	float get_block_time()
+	{
+		return static_cast<float>(accepted_block_duration) * 1e-6f;
+	}
+
 	// assumes Serial is already started
 	void begin(const char *serialNum, const char *swVersion, const char *device_type)
 	{
@@ -55,12 +290,308 @@ namespace scpi
 		          scpi_error_queue_data.data(), scpi_error_queue_data.size());
 	}
 
+	// returns false while input has to be held back
+	bool check_operations()
+	{
+		if (!opc_bit_pending && !waiting_for_operations)
+			return true;
+		if (!operation_complete_callback())
+		{
+			if (!waiting_for_operations)
+				return true;
+			if (millis() - wait_start < operation_timeout)
+				return false;
+			// give up without an answer, the host sees the timeout and can continue with *RST
+			SCPI_ErrorPushEx(&scpi_context, SCPI_ERROR_EXECUTION_ERROR, const_cast<char *>("Operation timeout"), 0);
+			waiting_for_operations = false;
+			opc_query_pending = false;
+			return true;
+		}
+
+		if (opc_bit_pending)
+		{
+			SCPI_RegSet(&scpi_context, SCPI_REG_ESR, SCPI_RegGet(&scpi_context, SCPI_REG_ESR) | ESR_OPC);
+			opc_bit_pending = false;
+		}
+		if (opc_query_pending)
+			Serial.print("1\r\n");
+		waiting_for_operations = false;
+		opc_query_pending = false;
+		return true;
+	}
+
+	void end_line()
+	{
+		line_len = 0;
+		quote = 0;
+		input_state = InputState::line;
+		// the command of a streamed block has been executed with the line end
+		block_status = BlockStatus::none;
+		line_passed = false;
+		line_streamed_block = false;
+	}
+
+	// SCPI_Input executes the buffered input when called with a length of 0, so empty input must not be passed
+	void input(const char *data, const size_t len)
+	{
+		if (len)
+			SCPI_Input(&scpi_context, data, static_cast<int>(len));
+	}
+
+	void flush_line()
+	{
+		input(line_buffer.data(), line_len);
+		line_len = 0;
+	}
+
+	// pass the held back line and the block header to the parser, the block goes through the input buffer
+	// the payload of a definite length block follows, anything else after the '#' is treated as part of the line
+	void pass_block_header(const bool definite_length)
+	{
+		flush_line();
+		line_passed = true;
+		input("#", 1);
+		input(block_header.data(), block_header_len);
+		if (definite_length)
+			input_state = block_length ? InputState::block_passthrough : InputState::passthrough;
+		else if (block_header[block_header_len - 1] == '\n')
+			end_line();
+		else
+			input_state = InputState::passthrough;
+	}
+
+	// sink for the header of the last command in the held back line
+	const BlockSink *find_block_sink()
+	{
+		size_t start{0};
+		char open_quote{0};
+		for (size_t i = 0; i < line_len; i++)
+		{
+			const char c = line_buffer[i];
+			if (open_quote)
+				open_quote = c == open_quote ? 0 : open_quote;
+			else if (c == '"' || c == '\'')
+				open_quote = c;
+			else if (c == ';')
+				start = i + 1;
+		}
+
+		while (start < line_len && (isspace(line_buffer[start]) || line_buffer[start] == ':'))
+			start++;
+		size_t end{start};
+		while (end < line_len && !isspace(line_buffer[end]))
+			end++;
+
+		for (const BlockSink *sink = block_sinks; sink->pattern; sink++)
+			if (SCPI_Match(sink->pattern, line_buffer.data() + start, end - start))
+				return sink;
+		return nullptr;
+	}
+
+	void end_block()
+	{
+		if (block_status == BlockStatus::accepted)
+		{
+			accepted_block_length = block_length;
+			accepted_block_duration = micros() - block_start;
+		}
+		memcpy(line_buffer.data() + line_len, block_placeholder, sizeof block_placeholder - 1);
+		line_len += sizeof block_placeholder - 1;
+		input_state = InputState::line;
+	}
+
+	void start_block()
+	{
+		block_length = 0;
+		for (size_t i = 1; i < block_header_len; i++)
+			block_length = block_length * 10 + (block_header[i] - '0');
+		block_received = 0;
+
+		// the parser executes a line once it is complete, so only one block per line can be held for it
+		block_sink = line_passed || line_streamed_block ? nullptr : find_block_sink();
+		if (!block_sink)
+		{
+			pass_block_header(true);
+			return;
+		}
+
+		line_streamed_block = true;
+		block_status = block_sink->begin(block_length) ? BlockStatus::accepted : BlockStatus::rejected;
+		block_start = micros();
+		last_block_byte = millis();
+		input_state = InputState::block_data;
+		if (block_length == 0)
+			end_block();
+	}
+
+	size_t feed_block_header(const char *data, const size_t len)
+	{
+		for (size_t i = 0; i < len; i++)
+		{
+			const char c = data[i];
+			block_header[block_header_len++] = c;
+			// indefinite length blocks (#0) and non decimal numbers (#H1F) are left to the parser
+			if (c < '0' || c > '9' || block_header[0] == '0')
+			{
+				pass_block_header(false);
+				return i + 1;
+			}
+			if (block_header_len == static_cast<size_t>(block_header[0] - '0') + 1)
+			{
+				start_block();
+				return i + 1;
+			}
+		}
+		return len;
+	}
+
+	size_t feed_block_passthrough(const char *data, const size_t len)
+	{
+		const size_t n = std::min(len, block_length - block_received);
+		input(data, n);
+		block_received += n;
+		if (block_received == block_length)
+			input_state = InputState::passthrough;
+		return n;
+	}
+
+	size_t feed_block(const char *data, const size_t len)
+	{
+		const size_t n = std::min(len, block_length - block_received);
+		if (block_status == BlockStatus::accepted)
+			block_sink->write(block_received, reinterpret_cast<const uint8_t *>(data), n);
+		block_received += n;
+		last_block_byte = millis();
+		if (block_received == block_length)
+			end_block();
+		return n;
+	}
+
+	// pass the rest of a line to the parser up to its end or the start of a block
+	size_t feed_passthrough(const char *data, const size_t len)
+	{
+		for (size_t i = 0; i < len; i++)
+		{
+			const char c = data[i];
+			if (c == '#' && !quote)
+			{
+				input(data, i);
+				block_header_len = 0;
+				input_state = InputState::block_header;
+				return i + 1;
+			}
+			if (c == '\n')
+			{
+				input(data, i + 1);
+				end_line();
+				return i + 1;
+			}
+			if (quote)
+				quote = c == quote ? 0 : quote;
+			else if (c == '"' || c == '\'')
+				quote = c;
+		}
+		input(data, len);
+		return len;
+	}
+
+	// pass input to the parser up to the end of a line or the start of a block, returns the number of bytes used
+	size_t feed(const char *data, const size_t len)
+	{
+		switch (input_state)
+		{
+			case InputState::block_header:
+				return feed_block_header(data, len);
+			case InputState::block_data:
+				return feed_block(data, len);
+			case InputState::block_passthrough:
+				return feed_block_passthrough(data, len);
+			case InputState::passthrough:
+				return feed_passthrough(data, len);
+			case InputState::line:
+				break;
+		}
+
+		for (size_t i = 0; i < len; i++)
+		{
+			const char c = data[i];
+			if (c == '#' && !quote)
+			{
+				block_header_len = 0;
+				input_state = InputState::block_header;
+				return i + 1;
+			}
+
+			line_buffer[line_len++] = c;
+			if (c == '\n')
+			{
+				flush_line();
+				end_line();
+				return i + 1;
+			}
+			if (quote)
+				quote = c == quote ? 0 : quote;
+			else if (c == '"' || c == '\'')
+				quote = c;
+
+			if (line_len >= line_buffer.size() - line_reserve)
+			{
+				flush_line();
+				line_passed = true;
+				input_state = InputState::passthrough;
+				return i + 1;
+			}
+		}
+		return len;
+	}
+
 	void loop()
 	{
-		while (Serial.available() > 0)
+		while (check_operations())
+		{
+			if (rx_pos == rx_len)
+			{
+				if (!Serial.available())
+					break;
+				rx_len = Serial.read(rx_chunk.data(), std::min<size_t>(Serial.available(), rx_chunk.size()));
+				rx_pos = 0;
+			}
+
+			// feed one line at a time, so *WAI can hold back the following lines
+			rx_pos += feed(rx_chunk.data() + rx_pos, rx_len - rx_pos);
+		}
+
+		// the host stopped in the middle of a block, execute its command with a rejected block
+		if (input_state == InputState::block_data && millis() - last_block_byte > block_timeout)
+		{
+			block_status = BlockStatus::rejected;
+			end_block();
+			line_buffer[line_len++] = '\n';
+			flush_line();
+			end_line();
+		}
+
+		// responses are always complete here, so a notification can't end up inside one
+		update_status();
+
+		// switch only after the response to the baud rate command has left the uart
+		if (pending_baud_rate)
+		{
+			Serial.flush();
+			Serial.updateBaudRate(pending_baud_rate);
+			baud_rate = pending_baud_rate;
+			pending_baud_rate = 0;
+			baud_rate_unconfirmed = baud_rate != confirmed_baud_rate;
+			baud_switch_time = millis();
+		}
+
+		// host did not confirm the new baud rate in time, fall back to the last working one
+		if (baud_rate_unconfirmed && millis() - baud_switch_time > baud_confirm_timeout)
 		{
-			const char c = Serial.read();
-			SCPI_Input(&scpi_context, &c, 1);
+			Serial.flush();
+			Serial.updateBaudRate(confirmed_baud_rate);
+			baud_rate = confirmed_baud_rate;
+			baud_rate_unconfirmed = false;
 		}
 	}
 } // namespace scpi
@@ -5,13 +5,83 @@
 #pragma once
 #include <scpi/scpi.h>
 
+namespace scpi {
+// receives the payload of a definite length block (#<n><length><data>) while it arrives, instead of through the input buffer
+struct BlockSink
+{
+	// header of the command that takes the block, the command is executed with the empty block #10 instead
+	const char *pattern;
+	// called before the payload, returns false to reject a block of this length, its payload is then discarded
+	bool (*begin)(size_t length);
+	// called with consecutive parts of the payload
+	void (*write)(size_t offset, const uint8_t *data, size_t len);
+};
+
+enum class BlockStatus : uint8_t
+{
+	none,
+	accepted,
+	rejected,
+};
+} // namespace scpi
+
 // must be implemented externally and contain the supported scpi commands
 extern const scpi_command_t scpi_commands[];
 scpi_result_t reset_callback(scpi_t *context);
+// must be implemented externally, returns false while operations started by commands (e.g. ramps) are running
+bool operation_complete_callback();
+// must be implemented externally, returns the current conditions of STATus:OPERation and STATus:QUEStionable
+void status_condition_callback(scpi_reg_val_t &operation, scpi_reg_val_t &questionable);
+// must be implemented externally and end with an entry with pattern nullptr
+extern const scpi::BlockSink block_sinks[];
 
 namespace scpi {
 
+// start Serial with the persisted baud rate
+void begin_serial();
+
 void begin(const char *serialNum, const char *swVersion, const char *device_type);
 
 void loop();
+
+// switch to a new baud rate after the current response is sent, returns false if the rate is not supported
+// the new rate must be confirmed within baud_confirm_timeout, otherwise the old rate is restored
+bool set_baud_rate(uint32_t baud);
+
+// confirm and persist a baud rate set by set_baud_rate
+void confirm_baud_rate();
+
+uint32_t get_baud_rate();
+
+// hold back further input until all operations are complete, then answer a pending *OPC? query
+void wait_for_operations(bool answer_query);
+
+// set the OPC bit of the event status register once all operations are complete
+void set_opc_when_complete();
+
+scpi_reg_val_t get_operation_condition();
+
+scpi_reg_val_t get_questionable_condition();
+
+// send the unsolicited line "!STATUS <operation>,<questionable>" when enabled event bits are set
+void set_status_notification(bool in);
+
+bool get_status_notification();
+
+// number of UART receive overruns (FIFO or ring buffer full) since boot
+uint32_t get_rx_overrun_count();
+
+// status of the block streamed to a sink in the line being executed
+// none if the line has no such block or the block went through the input buffer
+BlockStatus get_streamed_block();
+
+// status of the streamed block for the command whose block parameter is the placeholder, resets it to none,
+// so later commands in the same line don't see the block
+BlockStatus take_streamed_block();
+
+// length in bytes of the last accepted streamed block
+size_t get_block_length();
+
+// time in s from the block header to the last byte of the last accepted streamed block
+float get_block_time();
 } // namespace scpi
\ No newline at end of file
@@ -3,13 +3,20 @@
 //
 
 #include <Arduino.h>
+#include <calibration.hpp>
 #include <channel.hpp>
+#include <coupling.hpp>
+#include <datalogger.hpp>
+#include <event_log.hpp>
 #include <main.hpp>
+#include <screenshot.hpp>
 #include <scpi/scpi.h>
+#include <state_memory.hpp>
+#include <stream.hpp>
 
 #include "scpi_client.hpp"
 
-//index of the selected channel (0 or 1)
+//index of the selected channel (0 to channel_count - 1)
 uint8_t selected_channel{};
 
 //voltage step size
@@ -20,12 +27,60 @@ float voltage_step{voltage_step_default};
 constexpr float current_step_default{0.1};
 float current_step{current_step_default};
 
+//STATus:OPERation bits, set if any channel is in that state
+constexpr scpi_reg_val_t operation_ramping{1 << 1};
+constexpr scpi_reg_val_t operation_cv{1 << 8};
+constexpr scpi_reg_val_t operation_cc{1 << 10};
+constexpr scpi_reg_val_t operation_output_on{1 << 11};
+
+//STATus:QUEStionable bits, set if any channel is in that state
+constexpr scpi_reg_val_t questionable_over_voltage{1 << 0};
+constexpr scpi_reg_val_t questionable_over_current{1 << 1};
+constexpr scpi_reg_val_t questionable_module_missing{1 << 9};
+
 // IEEE 488.2 Commands
 scpi_result_t get_selftest(scpi_t *context);
 
+scpi_result_t operation_complete(scpi_t *context);
+
+scpi_result_t operation_complete_query(scpi_t *context);
+
+scpi_result_t wait_to_continue(scpi_t *context);
+
+scpi_result_t save_state(scpi_t *context);
+
+scpi_result_t recall_state(scpi_t *context);
+
+scpi_result_t set_power_on_recall(scpi_t *context);
+
+scpi_result_t get_power_on_recall(scpi_t *context);
+
+scpi_result_t get_state_valid(scpi_t *context);
+
 //No Operation
 scpi_result_t scpi_nop(scpi_t *context);
 
+// Status Commands
+scpi_result_t get_operation_event(scpi_t *context);
+
+scpi_result_t get_operation_condition(scpi_t *context);
+
+scpi_result_t set_operation_enable(scpi_t *context);
+
+scpi_result_t get_operation_enable(scpi_t *context);
+
+scpi_result_t get_questionable_event(scpi_t *context);
+
+scpi_result_t get_questionable_condition(scpi_t *context);
+
+scpi_result_t set_questionable_enable(scpi_t *context);
+
+scpi_result_t get_questionable_enable(scpi_t *context);
+
+scpi_result_t set_status_notification(scpi_t *context);
+
+scpi_result_t get_status_notification(scpi_t *context);
+
 // System Commands
 scpi_result_t set_beeper_state(scpi_t *context);
 
@@ -33,6 +88,20 @@ scpi_result_t get_beeper_state(scpi_t *context);
 
 scpi_result_t beep_immediate(scpi_t *context);
 
+scpi_result_t set_baud_rate(scpi_t *context);
+
+scpi_result_t get_baud_rate(scpi_t *context);
+
+scpi_result_t confirm_baud_rate(scpi_t *context);
+
+scpi_result_t get_rx_overrun_count(scpi_t *context);
+
+scpi_result_t get_event_log(scpi_t *context);
+
+scpi_result_t get_event_log_count(scpi_t *context);
+
+scpi_result_t clear_event_log(scpi_t *context);
+
 // Display Commands
 scpi_result_t set_display_text(scpi_t *context);
 
@@ -42,6 +111,8 @@ scpi_result_t set_brightness(scpi_t *context);
 
 scpi_result_t set_display_enabled(scpi_t *context);
 
+scpi_result_t get_screen_dump(scpi_t *context);
+
 //configuration commands
 scpi_result_t set_instrument_select(scpi_t *context);
 
@@ -71,6 +142,56 @@ scpi_result_t set_channel_state(scpi_t *context);
 
 scpi_result_t get_channel_state(scpi_t *context);
 
+scpi_result_t set_pair_mode(scpi_t *context);
+
+scpi_result_t get_pair_mode(scpi_t *context);
+
+scpi_result_t set_voltage_tracking(scpi_t *context);
+
+scpi_result_t get_voltage_tracking(scpi_t *context);
+
+scpi_result_t set_voltage_slew(scpi_t *context);
+
+scpi_result_t get_voltage_slew(scpi_t *context);
+
+scpi_result_t set_current_slew(scpi_t *context);
+
+scpi_result_t get_current_slew(scpi_t *context);
+
+scpi_result_t get_slew_progress(scpi_t *context);
+
+scpi_result_t set_voltage_protection_level(scpi_t *context);
+
+scpi_result_t get_voltage_protection_level(scpi_t *context);
+
+scpi_result_t set_voltage_protection_delay(scpi_t *context);
+
+scpi_result_t get_voltage_protection_delay(scpi_t *context);
+
+scpi_result_t set_voltage_protection_state(scpi_t *context);
+
+scpi_result_t get_voltage_protection_state(scpi_t *context);
+
+scpi_result_t get_voltage_protection_tripped(scpi_t *context);
+
+scpi_result_t clear_voltage_protection(scpi_t *context);
+
+scpi_result_t set_current_protection_level(scpi_t *context);
+
+scpi_result_t get_current_protection_level(scpi_t *context);
+
+scpi_result_t set_current_protection_delay(scpi_t *context);
+
+scpi_result_t get_current_protection_delay(scpi_t *context);
+
+scpi_result_t set_current_protection_state(scpi_t *context);
+
+scpi_result_t get_current_protection_state(scpi_t *context);
+
+scpi_result_t get_current_protection_tripped(scpi_t *context);
+
+scpi_result_t clear_current_protection(scpi_t *context);
+
 //Measurement Commands
 scpi_result_t measure_voltage(scpi_t *context);
 
@@ -78,6 +199,99 @@ scpi_result_t measure_current(scpi_t *context);
 
 scpi_result_t measure_power(scpi_t *context);
 
+scpi_result_t measure_voltage_min(scpi_t *context);
+
+scpi_result_t measure_voltage_max(scpi_t *context);
+
+scpi_result_t measure_voltage_ptp(scpi_t *context);
+
+scpi_result_t measure_current_min(scpi_t *context);
+
+scpi_result_t measure_current_max(scpi_t *context);
+
+scpi_result_t measure_current_ptp(scpi_t *context);
+
+scpi_result_t measure_charge(scpi_t *context);
+
+scpi_result_t measure_energy(scpi_t *context);
+
+scpi_result_t get_statistics_time(scpi_t *context);
+
+scpi_result_t clear_statistics(scpi_t *context);
+
+// Streaming Commands
+scpi_result_t set_stream_state(scpi_t *context);
+
+scpi_result_t get_stream_state(scpi_t *context);
+
+scpi_result_t set_stream_rate(scpi_t *context);
+
+scpi_result_t get_stream_rate(scpi_t *context);
+
+scpi_result_t set_stream_channels(scpi_t *context);
+
+scpi_result_t get_stream_channels(scpi_t *context);
+
+scpi_result_t get_stream_dropped(scpi_t *context);
+
+// datalogger
+scpi_result_t start_datalogger(scpi_t *context);
+
+scpi_result_t stop_datalogger(scpi_t *context);
+
+scpi_result_t get_datalogger_state(scpi_t *context);
+
+scpi_result_t set_datalogger_rate(scpi_t *context);
+
+scpi_result_t get_datalogger_rate(scpi_t *context);
+
+scpi_result_t set_datalogger_rotate_size(scpi_t *context);
+
+scpi_result_t get_datalogger_rotate_size(scpi_t *context);
+
+scpi_result_t get_datalogger_file(scpi_t *context);
+
+scpi_result_t get_datalogger_dropped(scpi_t *context);
+
+// Diagnostic Commands
+scpi_result_t get_protection_latency(scpi_t *context);
+
+scpi_result_t get_boot_time(scpi_t *context);
+
+// calibration
+scpi_result_t set_voltage_setpoint_calibration(scpi_t *context);
+
+scpi_result_t get_voltage_setpoint_calibration(scpi_t *context);
+
+scpi_result_t set_voltage_readback_calibration(scpi_t *context);
+
+scpi_result_t get_voltage_readback_calibration(scpi_t *context);
+
+scpi_result_t set_current_setpoint_calibration(scpi_t *context);
+
+scpi_result_t get_current_setpoint_calibration(scpi_t *context);
+
+scpi_result_t set_current_readback_calibration(scpi_t *context);
+
+scpi_result_t get_current_readback_calibration(scpi_t *context);
+
+scpi_result_t clear_calibration(scpi_t *context);
+
+scpi_result_t store_calibration(scpi_t *context);
+
+scpi_result_t test_block(scpi_t *context);
+
+scpi_result_t get_block_rate(scpi_t *context);
+
+// block sinks
+bool begin_calibration_block(size_t length);
+
+void write_calibration_block(size_t offset, const uint8_t *data, size_t len);
+
+bool begin_test_block(size_t length);
+
+void write_test_block(size_t offset, const uint8_t *data, size_t len);
+
 // setup helpers
 scpi_result_t change_i2c_adr(scpi_t *context);
 
@@ -89,21 +303,37 @@ const scpi_command_t scpi_commands[] = {
 	{ .pattern = "*ESE?", .callback = SCPI_CoreEseQ},
 	{ .pattern = "*ESR?", .callback = SCPI_CoreEsrQ},
 	{ .pattern = "*IDN?", .callback = SCPI_CoreIdnQ},
-	{ .pattern = "*OPC", .callback = SCPI_CoreOpc},
-	{ .pattern = "*OPC?", .callback = SCPI_CoreOpcQ},
+	{ .pattern = "*OPC", .callback = operation_complete},
+	{ .pattern = "*OPC?", .callback = operation_complete_query},
+	{ .pattern = "*RCL", .callback = recall_state},
 	{ .pattern = "*RST", .callback = SCPI_CoreRst},
+	{ .pattern = "*SAV", .callback = save_state},
 	{ .pattern = "*SRE", .callback = SCPI_CoreSre},
 	{ .pattern = "*SRE?", .callback = SCPI_CoreSreQ},
 	{ .pattern = "*STB?", .callback = SCPI_CoreStbQ},
 	{ .pattern = "*TST?", .callback = get_selftest},
-	{ .pattern = "*WAI", .callback = SCPI_CoreWai},
+	{ .pattern = "*WAI", .callback = wait_to_continue},
 
 	// Required SCPI commands (SCPI std V1999.0 4.2.1)
 	{.pattern = "SYSTem:ERRor[:NEXT]?", .callback = SCPI_SystemErrorNextQ},
 	{.pattern = "SYSTem:ERRor:COUNt?", .callback = SCPI_SystemErrorCountQ},
 	{.pattern = "SYSTem:VERSion?", .callback = SCPI_SystemVersionQ},
 
+	{.pattern = "MEMory:STATe:RECall:AUTO", .callback = set_power_on_recall},
+	{.pattern = "MEMory:STATe:RECall:AUTO?", .callback = get_power_on_recall},
+	{.pattern = "MEMory:STATe:VALid?", .callback = get_state_valid},
+
 	{.pattern = "STATus:PRESet", .callback = SCPI_StatusPreset},
+	{.pattern = "STATus:OPERation[:EVENt]?", .callback = get_operation_event},
+	{.pattern = "STATus:OPERation:CONDition?", .callback = get_operation_condition},
+	{.pattern = "STATus:OPERation:ENABle", .callback = set_operation_enable},
+	{.pattern = "STATus:OPERation:ENABle?", .callback = get_operation_enable},
+	{.pattern = "STATus:QUEStionable[:EVENt]?", .callback = get_questionable_event},
+	{.pattern = "STATus:QUEStionable:CONDition?", .callback = get_questionable_condition},
+	{.pattern = "STATus:QUEStionable:ENABle", .callback = set_questionable_enable},
+	{.pattern = "STATus:QUEStionable:ENABle?", .callback = get_questionable_enable},
+	{.pattern = "STATus:NOTification[:STATe]", .callback = set_status_notification},
+	{.pattern = "STATus:NOTification[:STATe]?", .callback = get_status_notification},
 
 	// System Commands
 	{.pattern = "SYSTem:BEEPer:STATe", .callback = set_beeper_state},
@@ -112,12 +342,20 @@ const scpi_command_t scpi_commands[] = {
 	{.pattern = "SYSTem:LOCal", .callback = scpi_nop},
 	{.pattern = "SYSTem:REMote", .callback = scpi_nop},
 	{.pattern = "SYSTem:RWLock", .callback = scpi_nop},
+	{.pattern = "SYSTem:COMMunicate:SERial:BAUD", .callback = set_baud_rate},
+	{.pattern = "SYSTem:COMMunicate:SERial:BAUD?", .callback = get_baud_rate},
+	{.pattern = "SYSTem:COMMunicate:SERial:BAUD:CONFirm", .callback = confirm_baud_rate},
+	{.pattern = "SYSTem:COMMunicate:SERial:OVERrun[:COUNt]?", .callback = get_rx_overrun_count},
+	{.pattern = "SYSTem:LOG[:DATA]?", .callback = get_event_log},
+	{.pattern = "SYSTem:LOG:COUNt?", .callback = get_event_log_count},
+	{.pattern = "SYSTem:LOG:CLEar", .callback = clear_event_log},
 
 	// Display Commands
 	{.pattern = "DISPlay[:WINDow]:TEXT:CLEar", .callback = display_text_clear},
 	{.pattern = "DISPlay[:WINDow]:TEXT[:DATA]", .callback = set_display_text},
 	{.pattern = "DISPlay:BRIGhtness", .callback = set_brightness},
 	{.pattern = "DISPlay:ENABle", .callback = set_display_enabled},
+	{.pattern = "HCOPy:SDUMp:DATA?", .callback = get_screen_dump},
 
 	//configuration commands
 	{.pattern = "INSTrument[:SELect]", .callback = set_instrument_select},
@@ -135,21 +373,109 @@ const scpi_command_t scpi_commands[] = {
 	{.pattern = "[SOURce]:CURRent[:LEVel]:STEP[:INCRement]", .callback = set_current_step},
 	{.pattern = "[SOURce]:CURRent[:LEVel]:STEP[:INCRement]?", .callback = get_current_step},
 
+	{.pattern = "[SOURce]:VOLTage:SLEW[:RATE]", .callback = set_voltage_slew},
+	{.pattern = "[SOURce]:VOLTage:SLEW[:RATE]?", .callback = get_voltage_slew},
+	{.pattern = "[SOURce]:CURRent:SLEW[:RATE]", .callback = set_current_slew},
+	{.pattern = "[SOURce]:CURRent:SLEW[:RATE]?", .callback = get_current_slew},
+	{.pattern = "[SOURce]:SLEW:PROGress?", .callback = get_slew_progress},
+
+	{.pattern = "[SOURce]:VOLTage:PROTection[:LEVel]", .callback = set_voltage_protection_level},
+	{.pattern = "[SOURce]:VOLTage:PROTection[:LEVel]?", .callback = get_voltage_protection_level},
+	{.pattern = "[SOURce]:VOLTage:PROTection:DELay", .callback = set_voltage_protection_delay},
+	{.pattern = "[SOURce]:VOLTage:PROTection:DELay?", .callback = get_voltage_protection_delay},
+	{.pattern = "[SOURce]:VOLTage:PROTection:STATe", .callback = set_voltage_protection_state},
+	{.pattern = "[SOURce]:VOLTage:PROTection:STATe?", .callback = get_voltage_protection_state},
+	{.pattern = "[SOURce]:VOLTage:PROTection:TRIPped?", .callback = get_voltage_protection_tripped},
+	{.pattern = "[SOURce]:VOLTage:PROTection:CLEar", .callback = clear_voltage_protection},
+
+	{.pattern = "[SOURce]:CURRent:PROTection[:LEVel]", .callback = set_current_protection_level},
+	{.pattern = "[SOURce]:CURRent:PROTection[:LEVel]?", .callback = get_current_protection_level},
+	{.pattern = "[SOURce]:CURRent:PROTection:DELay", .callback = set_current_protection_delay},
+	{.pattern = "[SOURce]:CURRent:PROTection:DELay?", .callback = get_current_protection_delay},
+	{.pattern = "[SOURce]:CURRent:PROTection:STATe", .callback = set_current_protection_state},
+	{.pattern = "[SOURce]:CURRent:PROTection:STATe?", .callback = get_current_protection_state},
+	{.pattern = "[SOURce]:CURRent:PROTection:TRIPped?", .callback = get_current_protection_tripped},
+	{.pattern = "[SOURce]:CURRent:PROTection:CLEar", .callback = clear_current_protection},
+
 	{.pattern = "APPLy", .callback = apply},
 	{.pattern = "APPLy?", .callback = apply_query},
 
 	{.pattern = "OUTPut[:CHANnel][:STATe]", .callback = set_channel_state},
 	{.pattern = "OUTPut[:CHANnel][:STATe]?", .callback = get_channel_state},
+	{.pattern = "OUTPut:PAIR", .callback = set_pair_mode},
+	{.pattern = "OUTPut:PAIR?", .callback = get_pair_mode},
+	{.pattern = "[SOURce]:VOLTage:TRACk[:STATe]", .callback = set_voltage_tracking},
+	{.pattern = "[SOURce]:VOLTage:TRACk[:STATe]?", .callback = get_voltage_tracking},
 
 	//Measurement Commands
 	{.pattern = "MEASure[:SCALar]:CURRent[:DC]?", .callback = measure_current},
 	{.pattern = "MEASure[:SCALar]:VOLTage[:DC]?", .callback = measure_voltage},
 	{.pattern = "MEASure[:SCALar]:POWer?", .callback = measure_power},
+	{.pattern = "MEASure[:SCALar]:VOLTage:MINimum?", .callback = measure_voltage_min},
+	{.pattern = "MEASure[:SCALar]:VOLTage:MAXimum?", .callback = measure_voltage_max},
+	{.pattern = "MEASure[:SCALar]:VOLTage:PTPeak?", .callback = measure_voltage_ptp},
+	{.pattern = "MEASure[:SCALar]:CURRent:MINimum?", .callback = measure_current_min},
+	{.pattern = "MEASure[:SCALar]:CURRent:MAXimum?", .callback = measure_current_max},
+	{.pattern = "MEASure[:SCALar]:CURRent:PTPeak?", .callback = measure_current_ptp},
+	{.pattern = "MEASure[:SCALar]:CHARge?", .callback = measure_charge},
+	{.pattern = "MEASure[:SCALar]:ENERgy?", .callback = measure_energy},
+	{.pattern = "CALCulate:CHARge?", .callback = measure_charge},
+	{.pattern = "CALCulate:ENERgy?", .callback = measure_energy},
+	{.pattern = "CALCulate:TIME?", .callback = get_statistics_time},
+	{.pattern = "CALCulate:CLEar", .callback = clear_statistics},
+
+	//Streaming Commands
+	{.pattern = "SENSe:STReam:STATe", .callback = set_stream_state},
+	{.pattern = "SENSe:STReam:STATe?", .callback = get_stream_state},
+	{.pattern = "SENSe:STReam:RATE", .callback = set_stream_rate},
+	{.pattern = "SENSe:STReam:RATE?", .callback = get_stream_rate},
+	{.pattern = "SENSe:STReam:CHANnel[:MASK]", .callback = set_stream_channels},
+	{.pattern = "SENSe:STReam:CHANnel[:MASK]?", .callback = get_stream_channels},
+	{.pattern = "SENSe:STReam:DROPped?", .callback = get_stream_dropped},
+
+	//Datalogger Commands
+	{.pattern = "DLOG:STARt", .callback = start_datalogger},
+	{.pattern = "DLOG:STOP", .callback = stop_datalogger},
+	{.pattern = "DLOG:STATe?", .callback = get_datalogger_state},
+	{.pattern = "DLOG:RATE", .callback = set_datalogger_rate},
+	{.pattern = "DLOG:RATE?", .callback = get_datalogger_rate},
+	{.pattern = "DLOG:ROTate[:SIZE]", .callback = set_datalogger_rotate_size},
+	{.pattern = "DLOG:ROTate[:SIZE]?", .callback = get_datalogger_rotate_size},
+	{.pattern = "DLOG:FILE?", .callback = get_datalogger_file},
+	{.pattern = "DLOG:DROPped?", .callback = get_datalogger_dropped},
+
+	//Diagnostic Commands
+	{.pattern = "DIAGnostic:PROTection:LATency?", .callback = get_protection_latency},
+	{.pattern = "DIAGnostic:BOOT:TIME?", .callback = get_boot_time},
+	{.pattern = "DIAGnostic:BLOCk:TEST", .callback = test_block},
+	{.pattern = "DIAGnostic:BLOCk:RATE?", .callback = get_block_rate},
+
+	//Calibration Commands
+	{.pattern = "CALibration:VOLTage[:SOURce]:DATA", .callback = set_voltage_setpoint_calibration},
+	{.pattern = "CALibration:VOLTage[:SOURce]:DATA?", .callback = get_voltage_setpoint_calibration},
+	{.pattern = "CALibration:VOLTage:MEASure:DATA", .callback = set_voltage_readback_calibration},
+	{.pattern = "CALibration:VOLTage:MEASure:DATA?", .callback = get_voltage_readback_calibration},
+	{.pattern = "CALibration:CURRent[:SOURce]:DATA", .callback = set_current_setpoint_calibration},
+	{.pattern = "CALibration:CURRent[:SOURce]:DATA?", .callback = get_current_setpoint_calibration},
+	{.pattern = "CALibration:CURRent:MEASure:DATA", .callback = set_current_readback_calibration},
+	{.pattern = "CALibration:CURRent:MEASure:DATA?", .callback = get_current_readback_calibration},
+	{.pattern = "CALibration:CLEar", .callback = clear_calibration},
+	{.pattern = "CALibration:STORe", .callback = store_calibration},
 
 	{.pattern = "I2C:ADRess[:SET]", .callback = change_i2c_adr},
 
 	SCPI_CMD_LIST_END
 };
+
+// commands whose block parameter is streamed to its destination instead of through the input buffer
+const scpi::BlockSink block_sinks[] = {
+	{.pattern = "CALibration:VOLTage[:SOURce]:DATA", .begin = begin_calibration_block, .write = write_calibration_block},
+	{.pattern = "CALibration:VOLTage:MEASure:DATA", .begin = begin_calibration_block, .write = write_calibration_block},
+	{.pattern = "CALibration:CURRent[:SOURce]:DATA", .begin = begin_calibration_block, .write = write_calibration_block},
+	{.pattern = "CALibration:CURRent:MEASure:DATA", .begin = begin_calibration_block, .write = write_calibration_block},
+	{.pattern = "DIAGnostic:BLOCk:TEST", .begin = begin_test_block, .write = write_test_block},
+	{.pattern = nullptr},
+};
 // clang-format on
 
 //
@@ -164,18 +490,173 @@ scpi_result_t reset_callback(scpi_t *)
 	beeper_active = true;
 	display_text[0] = 0;
 	display.setBrightness(0xFF);
-	channels[0].reset();
-	channels[1].reset();
+	for (Channel &channel: channels)
+		channel.reset();
+	stream::reset();
+	coupling::reset();
+	datalogger::reset();
+	return SCPI_RES_OK;
+}
+
+bool operation_complete_callback()
+{
+	for (const Channel &channel: channels)
+		if (channel.is_ramping())
+			return false;
+	return true;
+}
+
+void status_condition_callback(scpi_reg_val_t &operation, scpi_reg_val_t &questionable)
+{
+	for (const Channel &channel: channels)
+	{
+		if (channel.is_ramping())
+			operation |= operation_ramping;
+		if (channel.is_enabled())
+			operation |= operation_output_on | (channel.is_in_cc_mode() ? operation_cc : operation_cv);
+		if (channel.get_voltage_protection().tripped)
+			questionable |= questionable_over_voltage;
+		if (channel.get_current_protection().tripped)
+			questionable |= questionable_over_current;
+		if (!channel.is_connected())
+			questionable |= questionable_module_missing;
+	}
+}
+
+scpi_result_t operation_complete(scpi_t *context)
+{
+	if (operation_complete_callback())
+		return SCPI_CoreOpc(context);
+	scpi::set_opc_when_complete();
+	return SCPI_RES_OK;
+}
+
+scpi_result_t operation_complete_query(scpi_t *context)
+{
+	// the answer is sent by the scpi client when the running ramps are done
+	if (operation_complete_callback())
+		SCPI_ResultInt32(context, 1);
+	else
+		scpi::wait_for_operations(true);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t wait_to_continue(scpi_t *)
+{
+	if (!operation_complete_callback())
+		scpi::wait_for_operations(false);
+	return SCPI_RES_OK;
+}
+
+bool apply_state(const state_memory::State &state)
+{
+	voltage_step = state.voltage_step;
+	current_step = state.current_step;
+	beeper_active = state.beeper;
+	display.setBrightness(state.brightness);
+	bool res{true};
+	//coupled settings follow channel 1 with the next coupling loop
+	for (size_t i = 0; i < channels.size(); i++)
+	{
+		if (!coupling::is_voltage_coupled(i))
+			channels[i].set_voltage(state.channels[i].voltage);
+		if (coupling::is_output_coupled(i))
+			continue;
+		channels[i].set_current(state.channels[i].current);
+		if (!channels[i].set_enabled(state.channels[i].enabled))
+			res = false;
+	}
+	return res;
+}
+
+//parse and check the slot number of *SAV, *RCL and MEMory:STATe:VALid?, returns false on error
+bool parse_slot(scpi_t *context, uint8_t &slot)
+{
+	uint32_t res;
+	if (!SCPI_ParamUInt32(context, &res, true))
+		return false;
+
+	if (res >= state_memory::slot_count)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
+		return false;
+	}
+	slot = static_cast<uint8_t>(res);
+	return true;
+}
+
+scpi_result_t save_state(scpi_t *context)
+{
+	uint8_t slot;
+	if (!parse_slot(context, slot))
+		return SCPI_RES_ERR;
+
+	state_memory::State state{};
+	state.voltage_step = voltage_step;
+	state.current_step = current_step;
+	state.beeper = beeper_active;
+	state.brightness = display.getBrightness();
+	for (size_t i = 0; i < channels.size(); i++)
+		state.channels[i] = {channels[i].get_voltage(), channels[i].get_current(), channels[i].is_enabled()};
+
+	state_memory::save(slot, state);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t recall_state(scpi_t *context)
+{
+	uint8_t slot;
+	if (!parse_slot(context, slot))
+		return SCPI_RES_ERR;
+
+	state_memory::State state;
+	if (!state_memory::recall(slot, state))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_SAVE_RECALL_MEMORY_LOST);
+		return SCPI_RES_ERR;
+	}
+
+	// the other settings are still applied if an output can't be enabled because of a tripped protection
+	if (!apply_state(state))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_EXECUTION_ERROR);
+		return SCPI_RES_ERR;
+	}
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_power_on_recall(scpi_t *context)
+{
+	bool res;
+	if (!SCPI_ParamBool(context, &res, true))
+		return SCPI_RES_ERR;
+	state_memory::set_power_on_recall(res);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_power_on_recall(scpi_t *context)
+{
+	SCPI_ResultBool(context, state_memory::get_power_on_recall());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_state_valid(scpi_t *context)
+{
+	uint8_t slot;
+	if (!parse_slot(context, slot))
+		return SCPI_RES_ERR;
+
+	state_memory::State state;
+	SCPI_ResultBool(context, state_memory::recall(slot, state));
 	return SCPI_RES_OK;
 }
 
 scpi_result_t get_selftest(scpi_t *context)
 {
 	uint32_t res{};
-	if (!channels[0].is_connected())
-		res |= (1 << 0);
-	if (!channels[1].is_connected())
-		res |= (1 << 1);
+	for (size_t i = 0; i < channels.size(); i++)
+		if (!channels[i].is_connected())
+			res |= (1 << i);
 
 	SCPI_ResultUInt32(context, res);
 	return SCPI_RES_OK;
@@ -190,7 +671,9 @@ scpi_result_t set_instrument_select(scpi_t *context)
 {
 	scpi_number_t number;
 	constexpr scpi_choice_def_t special[] = {
-		{"OUTPut1", 1}, {"OUT1", 1}, {"OUTPut2", 2}, {"OUT2", 2}, SCPI_CHOICE_LIST_END
+		{"OUTPut1", 1}, {"OUT1", 1}, {"OUTPut2", 2}, {"OUT2", 2}, {"OUTPut3", 3}, {"OUT3", 3},
+		{"OUTPut4", 4}, {"OUT4", 4}, {"OUTPut5", 5}, {"OUT5", 5}, {"OUTPut6", 6}, {"OUT6", 6},
+		{"OUTPut7", 7}, {"OUT7", 7}, {"OUTPut8", 8}, {"OUT8", 8}, SCPI_CHOICE_LIST_END
 	};
 
 	if (!SCPI_ParamNumber(context, special, &number, true))
@@ -206,7 +689,7 @@ scpi_result_t set_instrument_select(scpi_t *context)
 	// get value from tag for special cases or from numeric value
 	const int32_t val{number.special ? number.content.tag : static_cast<int32_t>(number.content.value)};
 
-	if (val < 1 || val > 2)
+	if (val < 1 || val > static_cast<int32_t>(channels.size()))
 	{
 		SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
 		return SCPI_RES_ERR;
@@ -260,6 +743,12 @@ scpi_result_t set_voltage(scpi_t *context)
 		return SCPI_RES_ERR;
 	}
 
+	if (coupling::is_voltage_coupled(selected_channel))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_SETTINGS_CONFLICT);
+		return SCPI_RES_ERR;
+	}
+
 	channels[selected_channel].set_voltage(static_cast<float>(out_voltage));
 	return SCPI_RES_OK;
 }
@@ -364,6 +853,12 @@ scpi_result_t set_current(scpi_t *context)
 		return SCPI_RES_ERR;
 	}
 
+	if (coupling::is_output_coupled(selected_channel))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_SETTINGS_CONFLICT);
+		return SCPI_RES_ERR;
+	}
+
 	channels[selected_channel].set_current(static_cast<float>(out_current));
 	return SCPI_RES_OK;
 }
@@ -500,10 +995,28 @@ scpi_result_t apply(scpi_t *context)
 		}
 	}
 
-	constexpr scpi_choice_def_t special[] = {{"OUT1", 0}, {"OUT2", 1}, SCPI_CHOICE_LIST_END};
+	constexpr scpi_choice_def_t special[] = {
+		{"OUT1", 0}, {"OUT2", 1}, {"OUT3", 2}, {"OUT4", 3}, {"OUT5", 4}, {"OUT6", 5}, {"OUT7", 6}, {"OUT8", 7},
+		SCPI_CHOICE_LIST_END
+	};
 	int32_t tag_res{};
 	if (SCPI_ParamChoice(context, special, &tag_res, false))
+	{
+		if (tag_res >= static_cast<int32_t>(channels.size()))
+		{
+			SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
+			return SCPI_RES_ERR;
+		}
 		selected_channel = tag_res;
+	}
+
+	// the channel following another one only takes its settings from there
+	if (coupling::is_voltage_coupled(selected_channel) ||
+	    (!isnan(out_current) && coupling::is_output_coupled(selected_channel)))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_SETTINGS_CONFLICT);
+		return SCPI_RES_ERR;
+	}
 
 	channels[selected_channel].set_voltage(static_cast<float>(out_voltage));
 
@@ -525,7 +1038,13 @@ scpi_result_t set_channel_state(scpi_t *context)
 	bool res;
 	if (!SCPI_ParamBool(context, &res, true))
 		return SCPI_RES_ERR;
-	channels[selected_channel].set_enabled(res);
+
+	// a tripped protection has to be cleared first, a coupled channel is switched with the one it follows
+	if (coupling::is_output_coupled(selected_channel) || !channels[selected_channel].set_enabled(res))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_SETTINGS_CONFLICT);
+		return SCPI_RES_ERR;
+	}
 	return SCPI_RES_OK;
 }
 
@@ -535,87 +1054,1027 @@ scpi_result_t get_channel_state(scpi_t *context)
 	return SCPI_RES_OK;
 }
 
-scpi_result_t measure_voltage(scpi_t *context)
-{
-	SCPI_ResultFloat(context, channels[selected_channel].get_voltage_measurement());
-	return SCPI_RES_OK;
-}
-
-scpi_result_t measure_current(scpi_t *context)
-{
-	SCPI_ResultFloat(context, channels[selected_channel].get_current_measurement());
-	return SCPI_RES_OK;
-}
-
-scpi_result_t measure_power(scpi_t *context)
+scpi_result_t set_pair_mode(scpi_t *context)
 {
-	const float power{
-		channels[selected_channel].get_current_measurement() * channels[selected_channel].get_voltage_measurement()
+	constexpr scpi_choice_def_t modes[] = {
+		{"OFF", static_cast<int32_t>(coupling::PairMode::off)},
+		{"SERies", static_cast<int32_t>(coupling::PairMode::series)},
+		{"PARallel", static_cast<int32_t>(coupling::PairMode::parallel)},
+		SCPI_CHOICE_LIST_END
 	};
-	SCPI_ResultFloat(context, power);
+	int32_t mode;
+	if (!SCPI_ParamChoice(context, modes, &mode, true))
+		return SCPI_RES_ERR;
+
+	if (!coupling::set_pair_mode(static_cast<coupling::PairMode>(mode)))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+		return SCPI_RES_ERR;
+	}
 	return SCPI_RES_OK;
 }
 
-scpi_result_t change_i2c_adr(scpi_t *context)
+scpi_result_t get_pair_mode(scpi_t *context)
 {
-	uint32_t addr;
-	if (!SCPI_ParamUInt32(context, &addr, true))
-		return SCPI_RES_ERR;
-
-	channels[selected_channel].set_address(addr);
+	constexpr const char *names[]{"OFF", "SER", "PAR"};
+	SCPI_ResultMnemonic(context, names[static_cast<size_t>(coupling::get_pair_mode())]);
 	return SCPI_RES_OK;
 }
 
-scpi_result_t set_beeper_state(scpi_t *context)
+scpi_result_t set_voltage_tracking(scpi_t *context)
 {
 	bool res;
 	if (!SCPI_ParamBool(context, &res, true))
 		return SCPI_RES_ERR;
-	beeper_active = res;
-	return SCPI_RES_OK;
-}
 
-scpi_result_t get_beeper_state(scpi_t *context)
-{
-	SCPI_ResultBool(context, beeper_active);
+	if (!coupling::set_tracking(res))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_HARDWARE_MISSING);
+		return SCPI_RES_ERR;
+	}
 	return SCPI_RES_OK;
 }
 
-scpi_result_t beep_immediate(scpi_t *)
+scpi_result_t get_voltage_tracking(scpi_t *context)
 {
-	beep();
+	SCPI_ResultBool(context, coupling::is_tracking());
 	return SCPI_RES_OK;
 }
 
-scpi_result_t set_display_text(scpi_t *context)
-{
-	const char *text;
-	size_t len;
-	if (!SCPI_ParamCharacters(context, &text, &len, true))
-		return SCPI_RES_ERR;
-	strncpy(display_text, text, len);
-	return SCPI_RES_OK;
-}
+constexpr float max_slew{1000.0};
 
-scpi_result_t display_text_clear(scpi_t *)
+//shared implementation of the voltage and current slew commands, returns NAN on error
+float parse_slew(scpi_t *context)
 {
-	display_text[0] = 0;
-	return SCPI_RES_OK;
-}
+	scpi_number_t number;
+	constexpr scpi_choice_def_t special[] = {{"MIN", 1}, {"MAX", 2}, {"INFinity", 3}, {"DEFault", 3},
+	                                         SCPI_CHOICE_LIST_END};
 
-scpi_result_t set_brightness(scpi_t *context)
-{
-	double res;
-	if (!SCPI_ParamDouble(context, &res, true))
-		return SCPI_RES_ERR;
+	if (!SCPI_ParamNumber(context, special, &number, true))
+		return NAN;
 
-	if (res < 0 || res > 1)
+	// the parser has no unit for V/s or A/s
+	if (number.unit != SCPI_UNIT_NONE)
 	{
-		SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
-		return SCPI_RES_ERR;
+		SCPI_ErrorPush(context, SCPI_ERROR_INVALID_SUFFIX);
+		return NAN;
 	}
 
-	display.setBrightness(static_cast<uint8_t>(0xFF * res));
+	double slew{};
+	// get value from tag for special cases or from numeric value, 0 means no slew rate limit
+	if (number.special)
+	{
+		if (number.content.tag == 1)
+			slew = 0.001;
+		else if (number.content.tag == 2)
+			slew = max_slew;
+		else if (number.content.tag == 3)
+			slew = 0.0;
+	} else
+	{
+		slew = number.content.value;
+	}
+
+	if (slew < 0 || slew > max_slew)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
+		return NAN;
+	}
+	return static_cast<float>(slew);
+}
+
+scpi_result_t set_voltage_slew(scpi_t *context)
+{
+	const float slew{parse_slew(context)};
+	if (isnan(slew))
+		return SCPI_RES_ERR;
+
+	if (coupling::is_voltage_coupled(selected_channel))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_SETTINGS_CONFLICT);
+		return SCPI_RES_ERR;
+	}
+
+	channels[selected_channel].set_voltage_slew(slew);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_voltage_slew(scpi_t *context)
+{
+	SCPI_ResultFloat(context, channels[selected_channel].get_voltage_slew());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_current_slew(scpi_t *context)
+{
+	const float slew{parse_slew(context)};
+	if (isnan(slew))
+		return SCPI_RES_ERR;
+
+	if (coupling::is_output_coupled(selected_channel))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_SETTINGS_CONFLICT);
+		return SCPI_RES_ERR;
+	}
+
+	channels[selected_channel].set_current_slew(slew);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_current_slew(scpi_t *context)
+{
+	SCPI_ResultFloat(context, channels[selected_channel].get_current_slew());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_slew_progress(scpi_t *context)
+{
+	SCPI_ResultFloat(context, channels[selected_channel].get_ramp_progress());
+	return SCPI_RES_OK;
+}
+
+//shared implementation of the voltage and current protection commands
+scpi_result_t set_protection_level(scpi_t *context, Protection &protection, const scpi_unit_t unit, const float max)
+{
+	scpi_number_t number;
+	constexpr scpi_choice_def_t special[] = {{"MIN", 1}, {"MAX", 2}, SCPI_CHOICE_LIST_END};
+
+	if (!SCPI_ParamNumber(context, special, &number, true))
+		return SCPI_RES_ERR;
+
+	if (number.unit != SCPI_UNIT_NONE && number.unit != unit)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_INVALID_SUFFIX);
+		return SCPI_RES_ERR;
+	}
+
+	double level{};
+	// get value from tag for special cases or from numeric value
+	if (number.special)
+		level = number.content.tag == 1 ? 0.0 : max;
+	else
+		level = number.content.value;
+
+	if (level < 0 || level > max)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
+		return SCPI_RES_ERR;
+	}
+
+	protection.level = static_cast<float>(level);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_protection_level(scpi_t *context, const Protection &protection, const float max)
+{
+	constexpr scpi_choice_def_t special[] = {{"MIN", 1}, {"MAX", 2}, SCPI_CHOICE_LIST_END};
+	int32_t tag_res{};
+	if (SCPI_ParamChoice(context, special, &tag_res, false))
+		SCPI_ResultFloat(context, tag_res == 1 ? 0 : max);
+	else
+		SCPI_ResultFloat(context, protection.level);
+	return SCPI_RES_OK;
+}
+
+constexpr float max_protection_delay{10.0};
+
+scpi_result_t set_protection_delay(scpi_t *context, Protection &protection)
+{
+	scpi_number_t number;
+	constexpr scpi_choice_def_t special[] = {{"MIN", 1}, {"MAX", 2}, SCPI_CHOICE_LIST_END};
+
+	if (!SCPI_ParamNumber(context, special, &number, true))
+		return SCPI_RES_ERR;
+
+	// allow second or no unit
+	if (number.unit != SCPI_UNIT_NONE && number.unit != SCPI_UNIT_SECOND)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_INVALID_SUFFIX);
+		return SCPI_RES_ERR;
+	}
+
+	double delay{};
+	// get value from tag for special cases or from numeric value
+	if (number.special)
+		delay = number.content.tag == 1 ? 0.0 : max_protection_delay;
+	else
+		delay = number.content.value;
+
+	if (delay < 0 || delay > max_protection_delay)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
+		return SCPI_RES_ERR;
+	}
+
+	protection.delay = static_cast<float>(delay);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_protection_state(scpi_t *context, Protection &protection)
+{
+	bool res;
+	if (!SCPI_ParamBool(context, &res, true))
+		return SCPI_RES_ERR;
+	protection.enabled = res;
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_voltage_protection_level(scpi_t *context)
+{
+	return set_protection_level(context, channels[selected_channel].get_voltage_protection(), SCPI_UNIT_VOLT,
+	                            Channel::max_voltage);
+}
+
+scpi_result_t get_voltage_protection_level(scpi_t *context)
+{
+	return get_protection_level(context, channels[selected_channel].get_voltage_protection(), Channel::max_voltage);
+}
+
+scpi_result_t set_voltage_protection_delay(scpi_t *context)
+{
+	return set_protection_delay(context, channels[selected_channel].get_voltage_protection());
+}
+
+scpi_result_t get_voltage_protection_delay(scpi_t *context)
+{
+	SCPI_ResultFloat(context, channels[selected_channel].get_voltage_protection().delay);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_voltage_protection_state(scpi_t *context)
+{
+	return set_protection_state(context, channels[selected_channel].get_voltage_protection());
+}
+
+scpi_result_t get_voltage_protection_state(scpi_t *context)
+{
+	SCPI_ResultBool(context, channels[selected_channel].get_voltage_protection().enabled);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_voltage_protection_tripped(scpi_t *context)
+{
+	SCPI_ResultBool(context, channels[selected_channel].get_voltage_protection().tripped);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t clear_voltage_protection(scpi_t *)
+{
+	channels[selected_channel].get_voltage_protection().clear();
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_current_protection_level(scpi_t *context)
+{
+	return set_protection_level(context, channels[selected_channel].get_current_protection(), SCPI_UNIT_AMPER,
+	                            Channel::max_current);
+}
+
+scpi_result_t get_current_protection_level(scpi_t *context)
+{
+	return get_protection_level(context, channels[selected_channel].get_current_protection(), Channel::max_current);
+}
+
+scpi_result_t set_current_protection_delay(scpi_t *context)
+{
+	return set_protection_delay(context, channels[selected_channel].get_current_protection());
+}
+
+scpi_result_t get_current_protection_delay(scpi_t *context)
+{
+	SCPI_ResultFloat(context, channels[selected_channel].get_current_protection().delay);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_current_protection_state(scpi_t *context)
+{
+	return set_protection_state(context, channels[selected_channel].get_current_protection());
+}
+
+scpi_result_t get_current_protection_state(scpi_t *context)
+{
+	SCPI_ResultBool(context, channels[selected_channel].get_current_protection().enabled);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_current_protection_tripped(scpi_t *context)
+{
+	SCPI_ResultBool(context, channels[selected_channel].get_current_protection().tripped);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t clear_current_protection(scpi_t *)
+{
+	channels[selected_channel].get_current_protection().clear();
+	return SCPI_RES_OK;
+}
+
+//in a pair mode channel 1 reports the combined output
+scpi_result_t measure_voltage(scpi_t *context)
+{
+	SCPI_ResultFloat(context, coupling::get_voltage_measurement(selected_channel));
+	return SCPI_RES_OK;
+}
+
+scpi_result_t measure_current(scpi_t *context)
+{
+	SCPI_ResultFloat(context, coupling::get_current_measurement(selected_channel));
+	return SCPI_RES_OK;
+}
+
+scpi_result_t measure_power(scpi_t *context)
+{
+	const float power{
+		coupling::get_current_measurement(selected_channel) * coupling::get_voltage_measurement(selected_channel)
+	};
+	SCPI_ResultFloat(context, power);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_stream_state(scpi_t *context)
+{
+	bool res;
+	if (!SCPI_ParamBool(context, &res, true))
+		return SCPI_RES_ERR;
+	stream::set_enabled(res);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_stream_state(scpi_t *context)
+{
+	SCPI_ResultBool(context, stream::is_enabled());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_stream_rate(scpi_t *context)
+{
+	scpi_number_t number;
+	constexpr scpi_choice_def_t special[] = {{"MIN", 1}, {"MAX", 2}, {"DEFault", 3}, SCPI_CHOICE_LIST_END};
+
+	if (!SCPI_ParamNumber(context, special, &number, true))
+		return SCPI_RES_ERR;
+
+	// allow hertz or no unit
+	if (number.unit != SCPI_UNIT_NONE && number.unit != SCPI_UNIT_HERTZ)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_INVALID_SUFFIX);
+		return SCPI_RES_ERR;
+	}
+
+	double rate{};
+	// get value from tag for special cases or from numeric value
+	if (number.special)
+	{
+		if (number.content.tag == 1)
+			rate = 1;
+		else if (number.content.tag == 2)
+			rate = stream::max_rate;
+		else if (number.content.tag == 3)
+			rate = stream::default_rate;
+	} else
+	{
+		rate = number.content.value;
+	}
+
+	if (rate < 1 || rate > stream::max_rate)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
+		return SCPI_RES_ERR;
+	}
+
+	stream::set_rate(static_cast<uint32_t>(rate));
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_stream_rate(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, stream::get_rate());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_stream_channels(scpi_t *context)
+{
+	uint32_t mask;
+	if (!SCPI_ParamUInt32(context, &mask, true))
+		return SCPI_RES_ERR;
+
+	if (!stream::set_channel_mask(mask))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
+		return SCPI_RES_ERR;
+	}
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_stream_channels(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, stream::get_channel_mask());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_stream_dropped(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, stream::get_dropped_frames());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t start_datalogger(scpi_t *context)
+{
+	switch (datalogger::start())
+	{
+		case datalogger::StartResult::started:
+			return SCPI_RES_OK;
+		case datalogger::StartResult::no_card:
+			SCPI_ErrorPush(context, SCPI_ERROR_MISSING_MEDIA);
+			return SCPI_RES_ERR;
+		case datalogger::StartResult::busy:
+			SCPI_ErrorPush(context, SCPI_ERROR_MASS_STORAGE_ERROR);
+			return SCPI_RES_ERR;
+	}
+	return SCPI_RES_ERR;
+}
+
+scpi_result_t stop_datalogger(scpi_t *context)
+{
+	datalogger::stop();
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_datalogger_state(scpi_t *context)
+{
+	SCPI_ResultBool(context, datalogger::is_running());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_datalogger_rate(scpi_t *context)
+{
+	scpi_number_t number;
+	constexpr scpi_choice_def_t special[] = {{"MIN", 1}, {"MAX", 2}, {"DEFault", 3}, SCPI_CHOICE_LIST_END};
+
+	if (!SCPI_ParamNumber(context, special, &number, true))
+		return SCPI_RES_ERR;
+
+	// allow hertz or no unit
+	if (number.unit != SCPI_UNIT_NONE && number.unit != SCPI_UNIT_HERTZ)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_INVALID_SUFFIX);
+		return SCPI_RES_ERR;
+	}
+
+	double rate{};
+	// get value from tag for special cases or from numeric value
+	if (number.special)
+	{
+		if (number.content.tag == 1)
+			rate = 1;
+		else if (number.content.tag == 2)
+			rate = datalogger::max_rate;
+		else if (number.content.tag == 3)
+			rate = datalogger::default_rate;
+	} else
+	{
+		rate = number.content.value;
+	}
+
+	if (rate < 1 || rate > datalogger::max_rate)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
+		return SCPI_RES_ERR;
+	}
+
+	datalogger::set_rate(static_cast<uint32_t>(rate));
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_datalogger_rate(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, datalogger::get_rate());
+	return SCPI_RES_OK;
+}
+
+//file size in bytes after which a new file is started, 0 disables rotation
+scpi_result_t set_datalogger_rotate_size(scpi_t *context)
+{
+	uint32_t size;
+	if (!SCPI_ParamUInt32(context, &size, true))
+		return SCPI_RES_ERR;
+	datalogger::set_rotate_size(size);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_datalogger_rotate_size(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, datalogger::get_rotate_size());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_datalogger_file(scpi_t *context)
+{
+	SCPI_ResultText(context, datalogger::get_file_name());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_datalogger_dropped(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, datalogger::get_dropped_records());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t measure_voltage_min(scpi_t *context)
+{
+	SCPI_ResultFloat(context, channels[selected_channel].get_voltage_min());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t measure_voltage_max(scpi_t *context)
+{
+	SCPI_ResultFloat(context, channels[selected_channel].get_voltage_max());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t measure_voltage_ptp(scpi_t *context)
+{
+	const Channel &channel{channels[selected_channel]};
+	SCPI_ResultFloat(context, channel.get_voltage_max() - channel.get_voltage_min());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t measure_current_min(scpi_t *context)
+{
+	SCPI_ResultFloat(context, channels[selected_channel].get_current_min());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t measure_current_max(scpi_t *context)
+{
+	SCPI_ResultFloat(context, channels[selected_channel].get_current_max());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t measure_current_ptp(scpi_t *context)
+{
+	const Channel &channel{channels[selected_channel]};
+	SCPI_ResultFloat(context, channel.get_current_max() - channel.get_current_min());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t measure_charge(scpi_t *context)
+{
+	SCPI_ResultDouble(context, channels[selected_channel].get_charge());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t measure_energy(scpi_t *context)
+{
+	SCPI_ResultDouble(context, channels[selected_channel].get_energy());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_statistics_time(scpi_t *context)
+{
+	SCPI_ResultDouble(context, channels[selected_channel].get_statistics_time());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t clear_statistics(scpi_t *)
+{
+	channels[selected_channel].reset_statistics();
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_protection_latency(scpi_t *context)
+{
+	SCPI_ResultFloat(context, channels[selected_channel].get_worst_trip_latency());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_boot_time(scpi_t *context)
+{
+	SCPI_ResultFloat(context, static_cast<float>(ready_time) * 1e-6f);
+	return SCPI_RES_OK;
+}
+
+//send the setpoints through the changed tables
+void reapply_setpoints(Channel &channel)
+{
+	channel.set_voltage(channel.get_voltage());
+	channel.set_current(channel.get_current());
+}
+
+//binary calibration data as little endian float x,y pairs, written by the block sink while it arrives
+float calibration_block[2 * CalibrationTable::max_points];
+
+bool begin_calibration_block(const size_t length)
+{
+	return length % (2 * sizeof(float)) == 0 && length <= sizeof calibration_block;
+}
+
+void write_calibration_block(const size_t offset, const uint8_t *data, const size_t len)
+{
+	memcpy(reinterpret_cast<uint8_t *>(calibration_block) + offset, data, len);
+}
+
+//the command of a streamed block only gets the empty placeholder block, returns false if the block was rejected
+bool take_streamed_block(scpi_t *context)
+{
+	if (scpi::take_streamed_block() == scpi::BlockStatus::rejected)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_INVALID_BLOCK_DATA);
+		return false;
+	}
+	return true;
+}
+
+//data is a list of x,y pairs: nominal value, value to use instead
+scpi_result_t set_calibration(scpi_t *context, const CalibrationQuantity quantity)
+{
+	float ascii_data[2 * CalibrationTable::max_points];
+	const float *data{ascii_data};
+	size_t count{};
+
+	scpi_parameter_t param;
+	if (!SCPI_Parameter(context, &param, true))
+		return SCPI_RES_ERR;
+
+	if (param.type == SCPI_TOKEN_ARBITRARY_PROGRAM_DATA)
+	{
+		// a block that came through the input buffer holds the data itself
+		if (scpi::get_streamed_block() == scpi::BlockStatus::none)
+		{
+			if (!begin_calibration_block(param.len))
+			{
+				SCPI_ErrorPush(context, SCPI_ERROR_INVALID_BLOCK_DATA);
+				return SCPI_RES_ERR;
+			}
+			write_calibration_block(0, reinterpret_cast<const uint8_t *>(param.ptr), param.len);
+			count = param.len / sizeof(float);
+		} else
+		{
+			if (!take_streamed_block(context))
+				return SCPI_RES_ERR;
+			count = scpi::get_block_length() / sizeof(float);
+		}
+		data = calibration_block;
+	} else
+	{
+		if (!SCPI_ParamToFloat(context, &param, &ascii_data[0]))
+			return SCPI_RES_ERR;
+		if (!SCPI_ParamArrayFloat(context, ascii_data + 1, 2 * CalibrationTable::max_points - 1, &count,
+		                          SCPI_FORMAT_ASCII, false))
+			return SCPI_RES_ERR;
+		count++;
+	}
+
+	if (count % 2 != 0)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_ILLEGAL_PARAMETER_VALUE);
+		return SCPI_RES_ERR;
+	}
+
+	float x[CalibrationTable::max_points];
+	float y[CalibrationTable::max_points];
+	for (size_t i = 0; i < count / 2; i++)
+	{
+		x[i] = data[2 * i];
+		y[i] = data[2 * i + 1];
+	}
+
+	Channel &channel = channels[selected_channel];
+	if (!channel.get_calibration(quantity).set(x, y, count / 2))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_ILLEGAL_PARAMETER_VALUE);
+		return SCPI_RES_ERR;
+	}
+
+	reapply_setpoints(channel);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_calibration(scpi_t *context, const CalibrationQuantity quantity)
+{
+	const CalibrationTable &table = channels[selected_channel].get_calibration(quantity);
+	// the host waits for a line, so an empty table is answered with an empty string instead of a value
+	if (table.size() == 0)
+	{
+		SCPI_ResultText(context, "");
+		return SCPI_RES_OK;
+	}
+
+	float data[2 * CalibrationTable::max_points];
+	for (size_t i = 0; i < table.size(); i++)
+	{
+		data[2 * i] = table.get_x(i);
+		data[2 * i + 1] = table.get_y(i);
+	}
+	SCPI_ResultArrayFloat(context, data, 2 * table.size(), SCPI_FORMAT_ASCII);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_voltage_setpoint_calibration(scpi_t *context)
+{
+	return set_calibration(context, CalibrationQuantity::voltage_setpoint);
+}
+
+scpi_result_t get_voltage_setpoint_calibration(scpi_t *context)
+{
+	return get_calibration(context, CalibrationQuantity::voltage_setpoint);
+}
+
+scpi_result_t set_voltage_readback_calibration(scpi_t *context)
+{
+	return set_calibration(context, CalibrationQuantity::voltage_readback);
+}
+
+scpi_result_t get_voltage_readback_calibration(scpi_t *context)
+{
+	return get_calibration(context, CalibrationQuantity::voltage_readback);
+}
+
+scpi_result_t set_current_setpoint_calibration(scpi_t *context)
+{
+	return set_calibration(context, CalibrationQuantity::current_setpoint);
+}
+
+scpi_result_t get_current_setpoint_calibration(scpi_t *context)
+{
+	return get_calibration(context, CalibrationQuantity::current_setpoint);
+}
+
+scpi_result_t set_current_readback_calibration(scpi_t *context)
+{
+	return set_calibration(context, CalibrationQuantity::current_readback);
+}
+
+scpi_result_t get_current_readback_calibration(scpi_t *context)
+{
+	return get_calibration(context, CalibrationQuantity::current_readback);
+}
+
+scpi_result_t clear_calibration(scpi_t *)
+{
+	Channel &channel = channels[selected_channel];
+	for (size_t i = 0; i < calibration_quantity_count; i++)
+		channel.get_calibration(static_cast<CalibrationQuantity>(i)).clear();
+	reapply_setpoints(channel);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t store_calibration(scpi_t *)
+{
+	calibration::store();
+	return SCPI_RES_OK;
+}
+
+bool begin_test_block(const size_t)
+{
+	return true;
+}
+
+//the payload is discarded, so the upload rate can be measured with blocks of any length
+void write_test_block(const size_t, const uint8_t *, const size_t)
+{
+}
+
+scpi_result_t test_block(scpi_t *context)
+{
+	const char *placeholder;
+	size_t placeholder_len;
+	if (!SCPI_ParamArbitraryBlock(context, &placeholder, &placeholder_len, true))
+		return SCPI_RES_ERR;
+
+	if (scpi::get_streamed_block() == scpi::BlockStatus::none)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_BLOCK_DATA_ERROR);
+		return SCPI_RES_ERR;
+	}
+	return take_streamed_block(context) ? SCPI_RES_OK : SCPI_RES_ERR;
+}
+
+//length in bytes, duration in s and rate in bytes/s of the last streamed block
+scpi_result_t get_block_rate(scpi_t *context)
+{
+	const size_t length{scpi::get_block_length()};
+	const float time{scpi::get_block_time()};
+	SCPI_ResultUInt32(context, length);
+	SCPI_ResultFloat(context, time);
+	SCPI_ResultFloat(context, time > 0 ? static_cast<float>(length) / time : 0.0f);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t change_i2c_adr(scpi_t *context)
+{
+	uint32_t addr;
+	if (!SCPI_ParamUInt32(context, &addr, true))
+		return SCPI_RES_ERR;
+
+	channels[selected_channel].set_address(addr);
+	return SCPI_RES_OK;
+}
+
+//reading an event register clears it
+scpi_result_t get_operation_event(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, SCPI_RegGet(context, SCPI_REG_OPER));
+	SCPI_RegSet(context, SCPI_REG_OPER, 0);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_operation_condition(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, scpi::get_operation_condition());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_operation_enable(scpi_t *context)
+{
+	uint32_t res;
+	if (!SCPI_ParamUInt32(context, &res, true))
+		return SCPI_RES_ERR;
+	SCPI_RegSet(context, SCPI_REG_OPERE, static_cast<scpi_reg_val_t>(res));
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_operation_enable(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, SCPI_RegGet(context, SCPI_REG_OPERE));
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_questionable_event(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, SCPI_RegGet(context, SCPI_REG_QUES));
+	SCPI_RegSet(context, SCPI_REG_QUES, 0);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_questionable_condition(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, scpi::get_questionable_condition());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_questionable_enable(scpi_t *context)
+{
+	uint32_t res;
+	if (!SCPI_ParamUInt32(context, &res, true))
+		return SCPI_RES_ERR;
+	SCPI_RegSet(context, SCPI_REG_QUESE, static_cast<scpi_reg_val_t>(res));
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_questionable_enable(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, SCPI_RegGet(context, SCPI_REG_QUESE));
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_status_notification(scpi_t *context)
+{
+	bool res;
+	if (!SCPI_ParamBool(context, &res, true))
+		return SCPI_RES_ERR;
+	scpi::set_status_notification(res);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_status_notification(scpi_t *context)
+{
+	SCPI_ResultBool(context, scpi::get_status_notification());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_beeper_state(scpi_t *context)
+{
+	bool res;
+	if (!SCPI_ParamBool(context, &res, true))
+		return SCPI_RES_ERR;
+	beeper_active = res;
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_beeper_state(scpi_t *context)
+{
+	SCPI_ResultBool(context, beeper_active);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t beep_immediate(scpi_t *)
+{
+	beep();
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_baud_rate(scpi_t *context)
+{
+	uint32_t baud;
+	if (!SCPI_ParamUInt32(context, &baud, true))
+		return SCPI_RES_ERR;
+
+	if (!scpi::set_baud_rate(baud))
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_ILLEGAL_PARAMETER_VALUE);
+		return SCPI_RES_ERR;
+	}
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_baud_rate(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, scpi::get_baud_rate());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t confirm_baud_rate(scpi_t *)
+{
+	scpi::confirm_baud_rate();
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_rx_overrun_count(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, scpi::get_rx_overrun_count());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_event_log(scpi_t *context)
+{
+	constexpr scpi_choice_def_t special[] = {{"ASCii", 0}, {"BINary", 1}, SCPI_CHOICE_LIST_END};
+	int32_t format{0};
+	SCPI_ParamChoice(context, special, &format, false);
+
+	if (format == 1)
+	{
+		// records as stored, oldest first, without copying the ring buffer
+		const event_log::Record *first, *second;
+		size_t first_len, second_len;
+		event_log::get_parts(first, first_len, second, second_len);
+		SCPI_ResultArbitraryBlockHeader(context, (first_len + second_len) * sizeof(event_log::Record));
+		SCPI_ResultArbitraryBlockData(context, first, first_len * sizeof(event_log::Record));
+		SCPI_ResultArbitraryBlockData(context, second, second_len * sizeof(event_log::Record));
+		return SCPI_RES_OK;
+	}
+
+	// the host waits for a line, so an empty log has to be answered too
+	if (event_log::size() == 0)
+	{
+		SCPI_ResultText(context, "");
+		return SCPI_RES_OK;
+	}
+
+	// time in s, event code, channel (starting at 1, 0 for none), data for each record
+	for (size_t i = 0; i < event_log::size(); i++)
+	{
+		const event_log::Record &record = event_log::get(i);
+		SCPI_ResultDouble(context, static_cast<double>(record.time) * 1e-6);
+		SCPI_ResultUInt32(context, static_cast<uint32_t>(record.event));
+		SCPI_ResultUInt32(context, record.channel == event_log::no_channel ? 0 : record.channel + 1);
+		SCPI_ResultInt32(context, record.data);
+	}
+	return SCPI_RES_OK;
+}
+
+scpi_result_t get_event_log_count(scpi_t *context)
+{
+	SCPI_ResultUInt32(context, event_log::size());
+	SCPI_ResultUInt32(context, event_log::total());
+	return SCPI_RES_OK;
+}
+
+scpi_result_t clear_event_log(scpi_t *)
+{
+	event_log::clear();
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_display_text(scpi_t *context)
+{
+	const char *text;
+	size_t len;
+	if (!SCPI_ParamCharacters(context, &text, &len, true))
+		return SCPI_RES_ERR;
+	strncpy(display_text, text, len);
+	return SCPI_RES_OK;
+}
+
+scpi_result_t display_text_clear(scpi_t *)
+{
+	display_text[0] = 0;
+	return SCPI_RES_OK;
+}
+
+scpi_result_t set_brightness(scpi_t *context)
+{
+	double res;
+	if (!SCPI_ParamDouble(context, &res, true))
+		return SCPI_RES_ERR;
+
+	if (res < 0 || res > 1)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_DATA_OUT_OF_RANGE);
+		return SCPI_RES_ERR;
+	}
+
+	display.setBrightness(static_cast<uint8_t>(0xFF * res));
 	return SCPI_RES_OK;
 }
 
@@ -627,3 +2086,40 @@ scpi_result_t set_display_enabled(scpi_t *context)
 	display.setBrightness(res ? 0xFF : 0);
 	return SCPI_RES_OK;
 }
+
+//only writes what fits into the transmit buffer and polls the outputs while waiting for room,
+//so protection and ramps keep running at any baud rate
+void write_screen_dump(const uint8_t *data, size_t len, void *user)
+{
+	while (len)
+	{
+		const size_t room{static_cast<size_t>(Serial.availableForWrite())};
+		if (!room)
+		{
+			poll_outputs();
+			continue;
+		}
+		const size_t n{std::min(room, len)};
+		SCPI_ResultArbitraryBlockData(static_cast<scpi_t *>(user), data, n);
+		data += n;
+		len -= n;
+	}
+}
+
+//run length encoded canvas, encoded twice: once for the block length, then while sending
+//the canvas is only drawn between commands, so both passes see the same pixels
+scpi_result_t get_screen_dump(scpi_t *context)
+{
+	const auto *pixels = static_cast<const uint8_t *>(canvas.getBuffer());
+	if (!pixels || canvas.getColorDepth() != 8)
+	{
+		SCPI_ErrorPush(context, SCPI_ERROR_EXECUTION_ERROR);
+		return SCPI_RES_ERR;
+	}
+
+	const auto width = static_cast<uint16_t>(canvas.width());
+	const auto height = static_cast<uint16_t>(canvas.height());
+	SCPI_ResultArbitraryBlockHeader(context, screenshot::encode(pixels, width, height, nullptr, nullptr));
+	screenshot::encode(pixels, width, height, write_screen_dump, context);
+	return SCPI_RES_OK;
+}
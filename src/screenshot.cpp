@@ -0,0 +1,90 @@
+//
+// Created on 19.10.26.
+//
+
+#include "screenshot.hpp"
+
+#include <array>
+
+namespace screenshot
+{
+	constexpr size_t max_literal{128};
+	constexpr size_t max_run{129};
+
+	// collects output in small pieces, so the writer isn't called per byte
+	class Output
+	{
+		std::array<uint8_t, 64> buffer{};
+		size_t pos{0};
+		size_t total{0};
+		Writer write;
+		void *user;
+
+	public:
+		Output(const Writer write, void *user): write(write), user(user) {}
+
+		void flush()
+		{
+			if (write && pos)
+				write(buffer.data(), pos, user);
+			pos = 0;
+		}
+
+		void put(const uint8_t value)
+		{
+			total++;
+			if (!write)
+				return;
+			buffer[pos++] = value;
+			if (pos == buffer.size())
+				flush();
+		}
+
+		void put(const uint8_t *data, const size_t len)
+		{
+			for (size_t i = 0; i < len; i++)
+				put(data[i]);
+		}
+
+		size_t size() const { return total; }
+	};
+
+	size_t encode(const uint8_t *pixels, const uint16_t width, const uint16_t height, const Writer write, void *user)
+	{
+		Output out{write, user};
+		out.put(static_cast<uint8_t>(width));
+		out.put(static_cast<uint8_t>(width >> 8));
+		out.put(static_cast<uint8_t>(height));
+		out.put(static_cast<uint8_t>(height >> 8));
+		out.put(format_rgb332);
+
+		const size_t len{static_cast<size_t>(width) * height};
+		size_t i{0};
+		while (i < len)
+		{
+			size_t run{1};
+			while (i + run < len && run < max_run && pixels[i + run] == pixels[i])
+				run++;
+			if (run >= 2)
+			{
+				out.put(static_cast<uint8_t>(run + 126));
+				out.put(pixels[i]);
+				i += run;
+				continue;
+			}
+
+			// literal pixels up to the start of a run of three, a run of two costs as much as two literals
+			size_t literal{1};
+			while (i + literal < len && literal < max_literal &&
+			       !(i + literal + 2 < len && pixels[i + literal] == pixels[i + literal + 1] &&
+			         pixels[i + literal] == pixels[i + literal + 2]))
+				literal++;
+			out.put(static_cast<uint8_t>(literal - 1));
+			out.put(pixels + i, literal);
+			i += literal;
+		}
+
+		out.flush();
+		return out.size();
+	}
+} // namespace screenshot
@@ -0,0 +1,29 @@
+//
+// Created on 19.10.26.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// run length encoded canvas contents for HCOPy:SDUMp:DATA?
+//
+// layout (little endian):
+//   uint16  width
+//   uint16  height
+//   uint8   format           1: 8 bit RGB332 (rrrgggbb)
+//   packets until width * height pixels are decoded:
+//     uint8 n < 128          n + 1 pixels follow unchanged
+//     uint8 n >= 128         the next pixel repeats n - 126 times (2 to 129)
+namespace screenshot
+{
+	constexpr uint8_t format_rgb332{1};
+
+	// receives consecutive parts of the encoded data
+	using Writer = void (*)(const uint8_t *data, size_t len, void *user);
+
+	// encode the pixels in one pass without a copy, a writer of nullptr only counts the bytes
+	// returns the encoded length including the header
+	size_t encode(const uint8_t *pixels, uint16_t width, uint16_t height, Writer write, void *user);
+} // namespace screenshot
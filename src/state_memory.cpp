@@ -0,0 +1,121 @@
+//
+// Created on 19.10.26.
+//
+
+#include "state_memory.hpp"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <cstring>
+
+namespace state_memory
+{
+	// bump when State changes, older slots are treated as empty
+	constexpr uint8_t state_version{1};
+	// time in ms a slot has to stay unchanged before it is written, so a burst of *SAV costs one write
+	constexpr unsigned long write_delay{1000};
+
+	struct __attribute__((packed)) Slot
+	{
+		uint8_t version;
+		uint8_t channel_count;
+		State state;
+	};
+
+	std::array<Slot, slot_count> slots{};
+	std::array<bool, slot_count> dirty{};
+	bool power_on_recall{false};
+	bool power_on_dirty{false};
+	unsigned long last_save{};
+
+	void slot_key(const uint8_t slot, char (&key)[8])
+	{
+		snprintf(key, sizeof key, "slot%u", slot);
+	}
+
+	void begin()
+	{
+		Preferences preferences;
+		preferences.begin("state", true);
+		for (uint8_t slot = 0; slot < slot_count; slot++)
+		{
+			char key[8];
+			slot_key(slot, key);
+			if (preferences.getBytesLength(key) != sizeof(Slot) ||
+			    preferences.getBytes(key, &slots[slot], sizeof(Slot)) != sizeof(Slot))
+				slots[slot] = {};
+		}
+		power_on_recall = preferences.getBool("power_on", false);
+		preferences.end();
+	}
+
+	void save(const uint8_t slot, const State &state)
+	{
+		Slot &stored = slots[slot];
+		const Slot updated{state_version, channel_count, state};
+		if (memcmp(&stored, &updated, sizeof(Slot)) == 0)
+			return;
+		stored = updated;
+		dirty[slot] = true;
+		last_save = millis();
+	}
+
+	bool recall(const uint8_t slot, State &state)
+	{
+		const Slot &stored = slots[slot];
+		if (stored.version != state_version || stored.channel_count != channel_count)
+			return false;
+		state = stored.state;
+		return true;
+	}
+
+	void set_power_on_recall(const bool in)
+	{
+		if (in == power_on_recall)
+			return;
+		power_on_recall = in;
+		power_on_dirty = true;
+		last_save = millis();
+	}
+
+	bool get_power_on_recall()
+	{
+		return power_on_recall;
+	}
+
+	bool get_power_on_state(State &state)
+	{
+		return get_power_on_recall() && recall(0, state);
+	}
+
+	void loop()
+	{
+		if (millis() - last_save < write_delay)
+			return;
+
+		// one write per call, a flash write stalls both cores
+		if (power_on_dirty)
+		{
+			Preferences preferences;
+			preferences.begin("state", false);
+			preferences.putBool("power_on", power_on_recall);
+			preferences.end();
+			power_on_dirty = false;
+			return;
+		}
+
+		for (uint8_t slot = 0; slot < slot_count; slot++)
+		{
+			if (!dirty[slot])
+				continue;
+			char key[8];
+			slot_key(slot, key);
+			Preferences preferences;
+			preferences.begin("state", false);
+			preferences.putBytes(key, &slots[slot], sizeof(Slot));
+			preferences.end();
+			dirty[slot] = false;
+			return;
+		}
+	}
+} // namespace state_memory
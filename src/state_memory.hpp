@@ -0,0 +1,58 @@
+//
+// Created on 19.10.26.
+//
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "channel.hpp"
+
+// *SAV / *RCL slots in NVS, writes are deferred and skipped if nothing changed
+namespace state_memory
+{
+	// slot 0 is recalled on power on if enabled
+	constexpr uint8_t slot_count{5};
+
+	// packed, so slots are stored compactly and can be compared with memcmp
+	struct __attribute__((packed)) ChannelState
+	{
+		float voltage;
+		float current;
+		bool enabled;
+	};
+
+	struct __attribute__((packed)) State
+	{
+		float voltage_step;
+		float current_step;
+		uint8_t brightness;
+		bool beeper;
+		std::array<ChannelState, channel_count> channels;
+	};
+
+	// read the slots and the power on setting from NVS, so commands don't access the flash
+	void begin();
+
+	// store state in slot, written to NVS later by loop()
+	void save(uint8_t slot, const State &state);
+
+	// returns false if slot is empty or was saved by an incompatible firmware
+	bool recall(uint8_t slot, State &state);
+
+	// written to NVS later by loop()
+	void set_power_on_recall(bool in);
+
+	bool get_power_on_recall();
+
+	// returns false if the power on state is disabled or slot 0 is empty
+	bool get_power_on_state(State &state);
+
+	// write changed slots and the power on setting to NVS once they didn't change for a while
+	void loop();
+} // namespace state_memory
+
+// must be implemented externally, applies a recalled state
+// returns false if an output couldn't be enabled because a protection is tripped
+bool apply_state(const state_memory::State &state);
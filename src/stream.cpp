@@ -0,0 +1,142 @@
+//
+// Created on 19.10.26.
+//
+
+#include "stream.hpp"
+
+#include <Arduino.h>
+#include <array>
+
+#include "channel.hpp"
+
+namespace stream
+{
+	constexpr uint8_t sync_0{0xA5};
+	constexpr uint8_t sync_1{0x5A};
+	constexpr size_t channel_data_size{2 * sizeof(float) + 1};
+	constexpr size_t header_size{2 + 1 + 2 + 4 + 1};
+	constexpr size_t max_frame_size{header_size + channel_count * channel_data_size + 2};
+	constexpr uint8_t default_channel_mask{(1 << channel_count) - 1};
+
+	bool enabled{false};
+	uint32_t rate{default_rate};
+	uint8_t channel_mask{default_channel_mask};
+
+	uint16_t sequence{};
+	uint32_t dropped_frames{};
+	unsigned long next_frame_time{};
+
+	uint16_t crc16(const uint8_t *data, const size_t len)
+	{
+		uint16_t crc{0xFFFF};
+		for (size_t i = 0; i < len; i++)
+		{
+			crc ^= static_cast<uint16_t>(data[i]) << 8;
+			for (uint8_t bit = 0; bit < 8; bit++)
+				crc = crc & 0x8000 ? static_cast<uint16_t>(crc << 1 ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+		}
+		return crc;
+	}
+
+	template<typename T>
+	size_t put(uint8_t *buffer, const size_t pos, const T value)
+	{
+		memcpy(buffer + pos, &value, sizeof(T));
+		return pos + sizeof(T);
+	}
+
+	void set_enabled(const bool in)
+	{
+		if (in && !enabled)
+			next_frame_time = micros();
+		enabled = in;
+	}
+
+	bool is_enabled()
+	{
+		return enabled;
+	}
+
+	bool set_rate(const uint32_t in)
+	{
+		if (in < 1 || in > max_rate)
+			return false;
+		rate = in;
+		return true;
+	}
+
+	uint32_t get_rate()
+	{
+		return rate;
+	}
+
+	bool set_channel_mask(const uint32_t mask)
+	{
+		if (mask >> channels.size())
+			return false;
+		channel_mask = static_cast<uint8_t>(mask);
+		return true;
+	}
+
+	uint8_t get_channel_mask()
+	{
+		return channel_mask;
+	}
+
+	uint32_t get_dropped_frames()
+	{
+		return dropped_frames;
+	}
+
+	void loop()
+	{
+		if (!enabled)
+			return;
+
+		const unsigned long now = micros();
+		if (static_cast<long>(now - next_frame_time) < 0)
+			return;
+
+		// keep the frame grid, but don't try to catch up after a long stall
+		next_frame_time += 1000000UL / rate;
+		if (static_cast<long>(now - next_frame_time) > 0)
+			next_frame_time = now;
+
+		std::array<uint8_t, max_frame_size> frame;
+		size_t pos{0};
+		frame[pos++] = sync_0;
+		frame[pos++] = sync_1;
+		pos++; // length, filled in below
+		pos = put(frame.data(), pos, sequence++);
+		pos = put(frame.data(), pos, static_cast<uint32_t>(now));
+		frame[pos++] = channel_mask;
+
+		for (size_t i = 0; i < channels.size(); i++)
+		{
+			if (!(channel_mask & 1 << i))
+				continue;
+			const Channel &channel = channels[i];
+			pos = put(frame.data(), pos, channel.get_voltage_measurement());
+			pos = put(frame.data(), pos, channel.get_current_measurement());
+			frame[pos++] = channel.is_enabled() | channel.is_in_cc_mode() << 1 | channel.is_connected() << 2;
+		}
+
+		frame[2] = static_cast<uint8_t>(pos - 3);
+		pos = put(frame.data(), pos, crc16(frame.data() + 2, pos - 2));
+
+		// never block the poll loop, the host sees the gap in the sequence numbers
+		if (static_cast<size_t>(Serial.availableForWrite()) < pos)
+		{
+			dropped_frames++;
+			return;
+		}
+		Serial.write(frame.data(), pos);
+	}
+
+	void reset()
+	{
+		enabled = false;
+		rate = default_rate;
+		channel_mask = default_channel_mask;
+	}
+} // namespace stream
@@ -0,0 +1,49 @@
+//
+// Created on 19.10.26.
+//
+
+#pragma once
+
+#include <cstdint>
+
+// continuous measurement streaming
+//
+// frames are sent between responses, never inside one. 0xA5 doesn't occur in text responses, but may occur in the
+// data of binary blocks, so a receiver skips blocks by their length and only accepts frames with a matching CRC
+//
+// frame layout (little endian):
+//   0xA5 0x5A                sync
+//   uint8   length           number of bytes from sequence to the end of the channel data
+//   uint16  sequence         incremented for every frame, also for dropped ones
+//   uint32  timestamp        µs since boot
+//   uint8   channel mask     bit n set: data of channel n+1 follows
+//   per channel in mask:
+//     float voltage [V], float current [A], uint8 flags (bit0 enabled, bit1 cc mode, bit2 connected)
+//   uint16  crc              CRC-16/CCITT-FALSE over length to the end of the channel data
+namespace stream
+{
+	constexpr uint32_t max_rate{1000};
+	constexpr uint32_t default_rate{50};
+
+	void set_enabled(bool in);
+
+	bool is_enabled();
+
+	// frames per second, returns false if out of range
+	bool set_rate(uint32_t rate);
+
+	uint32_t get_rate();
+
+	// returns false if the mask selects channels that don't exist
+	bool set_channel_mask(uint32_t mask);
+
+	uint8_t get_channel_mask();
+
+	// frames skipped because the uart transmit buffer was full
+	uint32_t get_dropped_frames();
+
+	// send a frame if one is due, call after polling the channels
+	void loop();
+
+	void reset();
+} // namespace stream
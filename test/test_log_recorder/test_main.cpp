@@ -0,0 +1,240 @@
+//
+// Created on 19.10.26.
+//
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+#include "log_recorder.hpp"
+
+using namespace datalogger;
+
+namespace
+{
+	// the card, kept in memory
+	std::map<std::string, std::vector<uint8_t>> card;
+	std::string open_name;
+	int notifications{0};
+
+	bool file_exists(const char *name)
+	{
+		return card.count(name);
+	}
+
+	bool open_file(const char *name)
+	{
+		open_name = name;
+		card[open_name].clear();
+		return true;
+	}
+
+	bool write_file(const uint8_t *data, const size_t len)
+	{
+		card[open_name].insert(card[open_name].end(), data, data + len);
+		return true;
+	}
+
+	void close_file()
+	{
+		open_name.clear();
+	}
+
+	// the writer task is run by the tests, so they decide when it is busy
+	void notify()
+	{
+		notifications++;
+	}
+
+	constexpr FileOps files{file_exists, open_file, write_file, close_file};
+	constexpr size_t channel_count{2};
+	constexpr size_t record_size{8 + channel_count * channel_data_size};
+	constexpr size_t records_per_buffer{buffer_size / record_size};
+	constexpr ChannelSample samples[channel_count]{{5.0f, 0.1f, true, false, true}, {12.0f, 1.5f, true, true, true}};
+
+	void add(Recorder &recorder, const size_t count, const uint64_t timestamp = 0)
+	{
+		for (size_t i{0}; i < count; i++)
+			recorder.add(timestamp + i, samples);
+	}
+
+	// stop and let the writer close the file
+	void finish(Recorder &recorder)
+	{
+		recorder.stop();
+		recorder.loop();
+		recorder.write_pending();
+	}
+
+	size_t record_count(const std::string &name)
+	{
+		return (card[name].size() - header_size) / record_size;
+	}
+
+	uint64_t timestamp_of(const std::string &name, const size_t record)
+	{
+		uint64_t timestamp;
+		memcpy(&timestamp, card[name].data() + header_size + record * record_size, sizeof timestamp);
+		return timestamp;
+	}
+
+	void create_files(const uint32_t first, const uint32_t last)
+	{
+		char name[16];
+		for (uint32_t i{first}; i <= last; i++)
+		{
+			make_file_name(i, name);
+			card[name] = {0xAA};
+		}
+	}
+} // namespace
+
+void setUp()
+{
+	card.clear();
+	open_name.clear();
+	notifications = 0;
+}
+
+void tearDown()
+{
+}
+
+void test_records_are_encoded()
+{
+	Recorder recorder{files, channel_count, notify};
+	TEST_ASSERT_TRUE(recorder.start());
+	TEST_ASSERT_EQUAL_UINT32(1, recorder.get_file_index());
+	add(recorder, 2, 1000);
+	finish(recorder);
+
+	const std::vector<uint8_t> &file = card["/LOG0001.BIN"];
+	TEST_ASSERT_EQUAL_size_t(header_size + 2 * record_size, file.size());
+	const uint8_t header[header_size]{'P', 'S', 'U', 'L', version, channel_count, record_size, 0};
+	TEST_ASSERT_EQUAL_UINT8_ARRAY(header, file.data(), header_size);
+
+	const uint8_t *record = file.data() + header_size + record_size;
+	uint64_t timestamp;
+	float voltage;
+	float current;
+	memcpy(&timestamp, record, sizeof timestamp);
+	memcpy(&voltage, record + 8 + channel_data_size, sizeof voltage);
+	memcpy(&current, record + 8 + channel_data_size + 4, sizeof current);
+	TEST_ASSERT_EQUAL_UINT64(1001, timestamp);
+	TEST_ASSERT_EQUAL_FLOAT(12.0f, voltage);
+	TEST_ASSERT_EQUAL_FLOAT(1.5f, current);
+	TEST_ASSERT_EQUAL_UINT8(0b101, record[8 + 8]);
+	TEST_ASSERT_EQUAL_UINT8(0b111, record[8 + channel_data_size + 8]);
+	TEST_ASSERT_TRUE(open_name.empty());
+}
+
+void test_full_buffer_is_handed_off()
+{
+	Recorder recorder{files, channel_count, notify};
+	recorder.start();
+	add(recorder, records_per_buffer);
+	TEST_ASSERT_EQUAL_INT(0, notifications);
+
+	// the next record goes to the other buffer
+	add(recorder, 1, records_per_buffer);
+	TEST_ASSERT_EQUAL_INT(1, notifications);
+	TEST_ASSERT_FALSE(file_exists("/LOG0001.BIN"));
+	recorder.write_pending();
+	TEST_ASSERT_EQUAL_size_t(records_per_buffer, record_count("/LOG0001.BIN"));
+
+	finish(recorder);
+	TEST_ASSERT_EQUAL_size_t(records_per_buffer + 1, record_count("/LOG0001.BIN"));
+	TEST_ASSERT_EQUAL_UINT64(records_per_buffer, timestamp_of("/LOG0001.BIN", records_per_buffer));
+	TEST_ASSERT_EQUAL_UINT32(0, recorder.get_dropped_records());
+}
+
+void test_records_are_dropped_while_the_writer_is_busy()
+{
+	Recorder recorder{files, channel_count, notify};
+	recorder.start();
+	add(recorder, 2 * records_per_buffer);
+	// both buffers are full and the writer didn't take the first one yet
+	add(recorder, 3, 2 * records_per_buffer);
+	TEST_ASSERT_EQUAL_UINT32(3, recorder.get_dropped_records());
+
+	recorder.write_pending();
+	add(recorder, 1, 2 * records_per_buffer + 3);
+	recorder.write_pending();
+	finish(recorder);
+	TEST_ASSERT_EQUAL_size_t(2 * records_per_buffer + 1, record_count("/LOG0001.BIN"));
+	TEST_ASSERT_EQUAL_UINT64(2 * records_per_buffer + 3, timestamp_of("/LOG0001.BIN", 2 * records_per_buffer));
+}
+
+void test_start_skips_existing_files()
+{
+	create_files(1, 2);
+	Recorder recorder{files, channel_count, notify};
+	TEST_ASSERT_TRUE(recorder.start());
+	TEST_ASSERT_EQUAL_UINT32(3, recorder.get_file_index());
+	add(recorder, 1);
+	finish(recorder);
+	TEST_ASSERT_EQUAL_size_t(1, record_count("/LOG0003.BIN"));
+	TEST_ASSERT_EQUAL_size_t(1, card["/LOG0001.BIN"].size());
+
+	// the next start continues after the last file
+	TEST_ASSERT_TRUE(recorder.start());
+	TEST_ASSERT_EQUAL_UINT32(4, recorder.get_file_index());
+}
+
+void test_rotation_skips_existing_files()
+{
+	create_files(2, 3);
+	Recorder recorder{files, channel_count, notify};
+	recorder.set_rotate_size(header_size + 2 * record_size);
+	recorder.start();
+	add(recorder, 3);
+	recorder.write_pending();
+	add(recorder, 1, 3);
+	finish(recorder);
+
+	TEST_ASSERT_EQUAL_size_t(2, record_count("/LOG0001.BIN"));
+	TEST_ASSERT_EQUAL_size_t(1, card["/LOG0002.BIN"].size());
+	TEST_ASSERT_EQUAL_size_t(1, card["/LOG0003.BIN"].size());
+	TEST_ASSERT_EQUAL_size_t(2, record_count("/LOG0004.BIN"));
+	TEST_ASSERT_EQUAL_UINT64(2, timestamp_of("/LOG0004.BIN", 0));
+	TEST_ASSERT_EQUAL_UINT32(4, recorder.get_file_index());
+}
+
+void test_rotation_stops_without_free_name()
+{
+	create_files(max_file_index - 1, max_file_index);
+	Recorder recorder{files, channel_count, notify};
+	recorder.set_rotate_size(header_size + record_size);
+	TEST_ASSERT_TRUE(recorder.start());
+	TEST_ASSERT_EQUAL_UINT32(1, recorder.get_file_index());
+	create_files(2, max_file_index - 2);
+	add(recorder, 2);
+	recorder.write_pending();
+	// rotated away from the first file, but no name is left for the second one
+	add(recorder, 1, 2);
+	recorder.stop();
+	recorder.loop();
+	recorder.write_pending();
+
+	TEST_ASSERT_TRUE(recorder.loop() == Recorder::LoopResult::failed);
+	TEST_ASSERT_FALSE(recorder.is_running());
+	TEST_ASSERT_TRUE(open_name.empty());
+	TEST_ASSERT_EQUAL_size_t(1, record_count("/LOG0001.BIN"));
+	TEST_ASSERT_EQUAL_size_t(1, card["/LOG0002.BIN"].size());
+	TEST_ASSERT_EQUAL_size_t(1, card["/LOG9999.BIN"].size());
+	TEST_ASSERT_FALSE(recorder.start());
+}
+
+int main()
+{
+	UNITY_BEGIN();
+	RUN_TEST(test_records_are_encoded);
+	RUN_TEST(test_full_buffer_is_handed_off);
+	RUN_TEST(test_records_are_dropped_while_the_writer_is_busy);
+	RUN_TEST(test_start_skips_existing_files);
+	RUN_TEST(test_rotation_skips_existing_files);
+	RUN_TEST(test_rotation_stops_without_free_name);
+	return UNITY_END();
+}
@@ -1,16 +1,44 @@
+import argparse
 import time
-import lxi
 import serial
 import numpy as np
-import matplotlib.pyplot as plt
 
-# connect to electronic load
-info = lxi.LxiInfoClass()
+parser = argparse.ArgumentParser(description='current offset and measurement noise of the M5 Stack Supply')
+parser.add_argument('--port', default='/dev/ttyACM0', help='serial port of the supply')
+parser.add_argument('--sim', action='store_true', help='run against the simulated supply and load')
+parser.add_argument('--seed', type=int, default=0,
+                    help='noise seed of the simulation, runs with the same seed give the same results')
+parser.add_argument('--no-plot', action='store_true', help="don't show the plot")
+args = parser.parse_args()
 
+sim = None
 
-lxi.discover(info, lxi.DiscoverProtocol.VXI11)
+if args.sim:
+    import simulator
+
+    sim = simulator.SimulatedSupply(seed=args.seed)
+    load = simulator.SimulatedLoad(sim)
+    port = sim.serve_pty()
+else:
+    import lxi
+
+    # connect to electronic load
+    info = lxi.LxiInfoClass()
+
+    lxi.discover(info, lxi.DiscoverProtocol.VXI11)
+
+    load = lxi.Device(info.get_ip('RIGOL TECHNOLOGIES,DL3031A'), 0, "inst0", lxi.Protocol.VXI11)
+    port = args.port
+
+
+def sleep(seconds: float):
+    if sim:
+        # the simulated time only advances once the commands sent so far have been executed
+        supply.query('*OPC?')
+        sim.advance(seconds)
+    else:
+        time.sleep(seconds)
 
-load = lxi.Device(info.get_ip('RIGOL TECHNOLOGIES,DL3031A'), 0, "inst0", lxi.Protocol.VXI11)
 
 # connect to M5 Stack Supply
 class M5StackSupply:
@@ -33,7 +61,8 @@ class M5StackSupply:
         return line[:-2].decode()
 
 
-supply = M5StackSupply('/dev/ttyACM0')
+supply = M5StackSupply(port)
+run_start = time.time()
 
 voltages = [1, 2, 5, 10]
 current_max = 2.5
@@ -44,7 +73,7 @@ currents = np.arange(0, current_max+1E-4, current_step)
 supply.send_command('*RST')
 load.send('*RST')
 
-time.sleep(1)
+sleep(1)
 
 supply.send_command('APPLY 5.0V, 3.0A')
 supply.send_command('OUTPUT On')
@@ -60,11 +89,11 @@ i_load =np.zeros(currents.size)
 for i in range(currents.size):
     load.send(f'Current {currents[i]}A')
 
-    time.sleep(2)
+    sleep(2)
     i_temp = 0
     for _ in range(10):
         i_temp +=float(supply.query('Measure:Current?'))
-        time.sleep(0.2)
+        sleep(0.2)
     i_supply[i] = i_temp/10
     load.send('Measure:Current?')
     i_load[i] = float(load.receive())
@@ -76,7 +105,7 @@ supply.send_command('APPLY 5.0V, 3.0A')
 load.send(f'Current 0.5A')
 load.send('Input On')
 
-time.sleep(2)
+sleep(2)
 
 num_measures = 100
 measure_delay = 0.2
@@ -84,7 +113,7 @@ measure_delay = 0.2
 current_results = np.zeros(num_measures)
 voltage_results = np.zeros(num_measures)
 for i in range(num_measures):
-    time.sleep(measure_delay)
+    sleep(measure_delay)
     current_results[i] =float(supply.query('Measure:Current?'))
     voltage_results[i] =float(supply.query('Measure:Voltage?'))
 
@@ -95,15 +124,20 @@ print(f'Current Standard Deviation: {current_st_dev*1e6:.2f} µA')
 
 load.send('Input Off')
 
+print(f'Run time: {time.time() - run_start:.2f} s')
+
 # plot results
 offset = (i_supply-i_load)*1000
 
-plt.figure(figsize=(10, 5))
+if not args.no_plot:
+    import matplotlib.pyplot as plt
+
+    plt.figure(figsize=(10, 5))
 
-plt.plot(currents,offset)
+    plt.plot(currents,offset)
 
-plt.grid(True)
-plt.xlabel('$I [A]$')
-plt.ylabel('$\\Delta I [mA]$')
+    plt.grid(True)
+    plt.xlabel('$I [A]$')
+    plt.ylabel('$\\Delta I [mA]$')
 
-plt.show()
+    plt.show()
@@ -0,0 +1,62 @@
+import csv
+import struct
+import sys
+
+# decoder for the files of the M5 Stack Supply datalogger (DLOG:STARt)
+# layout: 8 byte header, then fixed size records, see src/datalogger.hpp
+
+MAGIC = b'PSUL'
+HEADER = '<4sBBH'
+VERSION = 2
+
+
+class Record:
+    def __init__(self, timestamp, channels):
+        # s since boot of the supply, continues across rotated files
+        self.timestamp = timestamp
+        # channel number (starting at 1) -> (voltage, current, enabled, cc_mode, connected)
+        self.channels = channels
+
+
+def decode(data: bytes) -> list:
+    magic, version, channel_count, record_size = struct.unpack_from(HEADER, data)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError('not a datalogger file')
+
+    records = []
+    # a power loss can leave a partial record at the end
+    for pos in range(struct.calcsize(HEADER), len(data) - record_size + 1, record_size):
+        timestamp, = struct.unpack_from('<Q', data, pos)
+        channels = {}
+        for ch in range(channel_count):
+            v, i, flags = struct.unpack_from('<ffB', data, pos + 8 + 9 * ch)
+            channels[ch + 1] = (v, i, bool(flags & 1), bool(flags & 2), bool(flags & 4))
+        records.append(Record(timestamp * 1e-6, channels))
+    return records
+
+
+def write_csv(records: list, out):
+    writer = csv.writer(out)
+    channel_count = len(records[0].channels) if records else 0
+    header = ['time']
+    for ch in range(1, channel_count + 1):
+        header += [f'ch{ch}_voltage', f'ch{ch}_current', f'ch{ch}_enabled', f'ch{ch}_cc']
+    writer.writerow(header)
+    for record in records:
+        row = [f'{record.timestamp:.6f}']
+        for ch in range(1, channel_count + 1):
+            v, i, enabled, cc, _ = record.channels[ch]
+            row += [f'{v:.4f}', f'{i:.5f}', int(enabled), int(cc)]
+        writer.writerow(row)
+
+
+if __name__ == '__main__':
+    # datalog.py LOG0001.BIN [LOG0002.BIN ...] > log.csv, files of a rotated recording are joined in the given order
+    if len(sys.argv) < 2:
+        print(f'usage: {sys.argv[0]} <file> [file ...]')
+        sys.exit(2)
+    records = []
+    for name in sys.argv[1:]:
+        with open(name, 'rb') as f:
+            records += decode(f.read())
+    write_csv(records, sys.stdout)
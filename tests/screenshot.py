@@ -0,0 +1,75 @@
+import struct
+import sys
+import zlib
+
+# screenshot of the M5 Stack Supply display (HCOPy:SDUMp:DATA?), layout described in src/screenshot.hpp
+
+FORMAT_RGB332 = 1
+
+
+def decode(data: bytes):
+    """returns width, height and the RGB332 pixels"""
+    width, height, fmt = struct.unpack_from('<HHB', data)
+    if fmt != FORMAT_RGB332:
+        raise ValueError(f'unknown pixel format {fmt}')
+    size = width * height
+    pixels = bytearray()
+    pos = 5
+    while len(pixels) < size:
+        n = data[pos]
+        if n < 128:
+            pixels += data[pos + 1:pos + 2 + n]
+            pos += 2 + n
+        else:
+            pixels += bytes([data[pos + 1]]) * (n - 126)
+            pos += 2
+    if len(pixels) != size:
+        raise ValueError('corrupt screenshot data')
+    return width, height, bytes(pixels)
+
+
+def to_rgb(pixels: bytes) -> bytes:
+    # expand 3/3/2 bits to the full 8 bit range
+    lut = [bytes([(p >> 5) * 255 // 7, (p >> 2 & 7) * 255 // 7, (p & 3) * 255 // 3]) for p in range(256)]
+    return b''.join(lut[p] for p in pixels)
+
+
+def write_ppm(path: str, width: int, height: int, rgb: bytes):
+    with open(path, 'wb') as f:
+        f.write(f'P6 {width} {height} 255\n'.encode() + rgb)
+
+
+def write_png(path: str, width: int, height: int, rgb: bytes):
+    def chunk(kind: bytes, body: bytes) -> bytes:
+        return struct.pack('>I', len(body)) + kind + body + struct.pack('>I', zlib.crc32(kind + body))
+
+    rows = b''.join(b'\x00' + rgb[y * width * 3:(y + 1) * width * 3] for y in range(height))
+    with open(path, 'wb') as f:
+        f.write(b'\x89PNG\r\n\x1a\n')
+        f.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, 8, 2, 0, 0, 0)))
+        f.write(chunk(b'IDAT', zlib.compress(rows, 9)))
+        f.write(chunk(b'IEND', b''))
+
+
+def read_block(link) -> bytes:
+    """reads a definite length block response from a serial link"""
+    if link.read(1) != b'#':
+        raise RuntimeError('no block in response')
+    digits = int(link.read(1))
+    length = int(link.read(digits))
+    data = link.read(length)
+    link.readline()
+    if len(data) != length:
+        raise RuntimeError('screenshot incomplete')
+    return data
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 3:
+        print(f'usage: {sys.argv[0]} <port> <file.png|file.ppm> [baud]')
+        sys.exit(2)
+    import serial
+    link = serial.Serial(sys.argv[1], int(sys.argv[3]) if len(sys.argv) > 3 else 115200, timeout=30)
+    link.write(b'HCOP:SDUM:DATA?\r\n')
+    w, h, p = decode(read_block(link))
+    (write_ppm if sys.argv[2].endswith('.ppm') else write_png)(sys.argv[2], w, h, to_rgb(p))
@@ -0,0 +1,328 @@
+import math
+import os
+import random
+import re
+import threading
+import tty
+
+# simulated M5 Stack Supply with an electronic load on channel 1, for running the characterization scripts without
+# hardware. The supply answers a subset of the firmware's SCPI commands over a pty, the load replaces the
+# lxi.Device of the RIGOL DL3031A in the same process.
+#
+# The simulation runs on its own clock, scripts call advance() instead of sleeping. Together with the seeded noise
+# generator a script that sends the same commands gets the same results, independent of the speed of the host.
+
+IDN = 'Graw Radiosondes,M5-PSU 2,SIMULATED,1.0.0'
+
+MAX_VOLTAGE = 12.0
+MAX_CURRENT = 5.0
+
+
+class Plant:
+    """PPS module with a load on its output, settling to the steady state with first order time constants."""
+
+    def __init__(self, rng: random.Random):
+        self.rng = rng
+        self.voltage_set = 0.0
+        self.current_set = 0.0
+        self.enabled = False
+
+        # output resistance and settling time constants
+        self.output_resistance = 0.02
+        self.voltage_tau = 2e-3
+        self.current_tau = 1e-3
+
+        # readback errors of the module
+        self.voltage_offset = 1.5e-3
+        self.voltage_gain = 1.002
+        self.voltage_noise = 150e-6
+        self.current_offset = 4e-3
+        self.current_gain = 0.995
+        self.current_noise = 400e-6
+
+        # load: None, ('CURR', amps) or ('RES', ohms)
+        self.load = None
+
+        self.voltage = 0.0
+        self.current = 0.0
+        self.time = 0.0
+
+    def steady_state(self):
+        """returns voltage, current and cc mode the output settles to"""
+        if not self.enabled:
+            return 0.0, 0.0, False
+        mode = self.load[0] if self.load else None
+        if mode == 'RES':
+            resistance = max(self.load[1], 1e-3)
+            current = self.voltage_set / (resistance + self.output_resistance)
+            if current <= self.current_set:
+                return current * resistance, current, False
+            return self.current_set * resistance, self.current_set, True
+        demand = self.load[1] if mode == 'CURR' else 0.0
+        if demand <= self.current_set:
+            return max(self.voltage_set - demand * self.output_resistance, 0.0), demand, False
+        # a constant current load pulls the output down to its minimum operating voltage
+        return min(self.voltage_set, 0.1), self.current_set, True
+
+    def update(self, now: float):
+        dt = max(now - self.time, 0.0)
+        self.time = now
+        voltage, current, _ = self.steady_state()
+        self.voltage += (voltage - self.voltage) * (1 - math.exp(-dt / self.voltage_tau))
+        self.current += (current - self.current) * (1 - math.exp(-dt / self.current_tau))
+
+    def is_cc_mode(self) -> bool:
+        return self.steady_state()[2]
+
+    def read_voltage(self) -> float:
+        if not self.enabled:
+            return 0.0
+        return self.voltage * self.voltage_gain + self.voltage_offset + self.rng.gauss(0, self.voltage_noise)
+
+    def read_current(self) -> float:
+        if not self.enabled:
+            return 0.0
+        return self.current * self.current_gain + self.current_offset + self.rng.gauss(0, self.current_noise)
+
+
+def pattern_regex(pattern: str):
+    """regex for a SCPI command pattern like 'MEASure[:SCALar]:CURRent[:DC]?', matched against ':' + header"""
+
+    def keyword(word: str) -> str:
+        short = ''.join(c for c in word if not c.islower())
+        return f'(?:{re.escape(word)}|{re.escape(short)})' if short != word else re.escape(word)
+
+    query = pattern.endswith('?')
+    regex = ''
+    for optional, node in re.findall(r'(\[?):?([^:\[\]?]+)\]?', pattern.rstrip('?')):
+        regex += f'(?::{keyword(node)})?' if optional else f':{keyword(node)}'
+    return re.compile(regex + ('\\?' if query else ''), re.IGNORECASE)
+
+
+def parse_value(text: str, unit: str) -> float:
+    text = text.strip()
+    match = re.fullmatch(r'([-+]?[0-9.]+(?:[eE][-+]?[0-9]+)?)\s*(m|u)?' + unit + '?', text, re.IGNORECASE)
+    if not match:
+        raise ValueError(text)
+    scale = {'m': 1e-3, 'u': 1e-6}.get((match.group(2) or '').lower(), 1.0)
+    return float(match.group(1)) * scale
+
+
+class SimulatedSupply:
+    def __init__(self, seed: int = 0, channels: int = 2):
+        self.rng = random.Random(seed)
+        # simulated time in s
+        self.time = 0.0
+        self.plants = [Plant(self.rng) for _ in range(channels)]
+        self.selected = 0
+        self.errors = []
+        self.lock = threading.Lock()
+        self.commands = [
+            ('*IDN?', lambda args: IDN),
+            ('*RST', self.reset),
+            ('*CLS', lambda args: self.errors.clear()),
+            ('*OPC?', lambda args: '1'),
+            ('SYSTem:ERRor[:NEXT]?', self.next_error),
+            ('INSTrument[:SELect]', self.select),
+            ('INSTrument[:SELect]?', lambda args: str(self.selected + 1)),
+            ('INSTrument:NSELect', self.select),
+            ('INSTrument:NSELect?', lambda args: str(self.selected + 1)),
+            ('[SOURce]:VOLTage[:LEVel][:IMMediate][:AMPLitude]', self.set_voltage),
+            ('[SOURce]:VOLTage[:LEVel][:IMMediate][:AMPLitude]?', lambda args: f'{self.plant.voltage_set:.3f}'),
+            ('[SOURce]:CURRent[:LEVel][:IMMediate][:AMPLitude]', self.set_current),
+            ('[SOURce]:CURRent[:LEVel][:IMMediate][:AMPLitude]?', lambda args: f'{self.plant.current_set:.3f}'),
+            ('APPLy', self.apply),
+            ('APPLy?', lambda args: f'{self.plant.voltage_set:.3f},{self.plant.current_set:.3f}'),
+            ('OUTPut[:CHANnel][:STATe]', self.set_output),
+            ('OUTPut[:CHANnel][:STATe]?', lambda args: str(int(self.plant.enabled))),
+            ('MEASure[:SCALar]:VOLTage[:DC]?', lambda args: f'{self.plant.read_voltage():.6f}'),
+            ('MEASure[:SCALar]:CURRent[:DC]?', lambda args: f'{self.plant.read_current():.6f}'),
+            ('MEASure[:SCALar]:POWer?',
+             lambda args: f'{self.plant.read_voltage() * self.plant.read_current():.6f}'),
+        ]
+        self.commands = [(pattern_regex(pattern), callback) for pattern, callback in self.commands]
+
+    @property
+    def plant(self) -> Plant:
+        return self.plants[self.selected]
+
+    def now(self) -> float:
+        return self.time
+
+    def advance(self, seconds: float):
+        """let the simulated time pass, commands sent over the pty must have been answered before"""
+        with self.lock:
+            self.time += seconds
+
+    def reset(self, args):
+        for plant in self.plants:
+            plant.voltage_set = plant.current_set = 0.0
+            plant.enabled = False
+        self.selected = 0
+
+    def next_error(self, args):
+        return self.errors.pop(0) if self.errors else '0,"No error"'
+
+    def select(self, args):
+        match = re.fullmatch(r'(?:OUT(?:PUT)?)?([0-9])', args.strip(), re.IGNORECASE)
+        if not match or not 1 <= int(match.group(1)) <= len(self.plants):
+            raise ValueError(args)
+        self.selected = int(match.group(1)) - 1
+
+    def set_voltage(self, args):
+        value = parse_value(args, 'V')
+        if not 0 <= value <= MAX_VOLTAGE:
+            raise ValueError(args)
+        self.plant.voltage_set = value
+
+    def set_current(self, args):
+        value = parse_value(args, 'A')
+        if not 0 <= value <= MAX_CURRENT:
+            raise ValueError(args)
+        self.plant.current_set = value
+
+    def apply(self, args):
+        params = args.split(',')
+        if len(params) == 3:
+            self.select(params[2])
+        self.set_voltage(params[0])
+        if len(params) > 1:
+            self.set_current(params[1])
+
+    def set_output(self, args):
+        state = args.strip().upper()
+        if state not in ('ON', 'OFF', '1', '0'):
+            raise ValueError(args)
+        self.plant.enabled = state in ('ON', '1')
+
+    def execute(self, line: str):
+        """runs one line of commands, returns the responses"""
+        responses = []
+        with self.lock:
+            now = self.now()
+            for plant in self.plants:
+                plant.update(now)
+            for command in filter(None, (c.strip() for c in line.split(';'))):
+                header, _, args = command.partition(' ')
+                for regex, callback in self.commands:
+                    if regex.fullmatch(':' + header.lstrip(':')):
+                        try:
+                            response = callback(args)
+                        except (ValueError, IndexError):
+                            self.errors.append('-224,"Illegal parameter value"')
+                            break
+                        if response is not None:
+                            responses.append(response)
+                        break
+                else:
+                    self.errors.append('-113,"Undefined header"')
+        return responses
+
+    def serve_pty(self) -> str:
+        """answers commands on a new pty, returns its device name for serial.Serial()"""
+        master, slave = os.openpty()
+        tty.setraw(slave)
+
+        def serve():
+            buffer = b''
+            while True:
+                try:
+                    data = os.read(master, 1024)
+                except OSError:
+                    return
+                buffer += data
+                while b'\n' in buffer:
+                    line, buffer = buffer.split(b'\n', 1)
+                    for response in self.execute(line.decode(errors='replace')):
+                        os.write(master, response.encode() + b'\r\n')
+
+        threading.Thread(target=serve, daemon=True).start()
+        return os.ttyname(slave)
+
+
+class SimulatedLoad:
+    """stand-in for the lxi.Device of a RIGOL DL3031A, connected to one channel of a simulated supply"""
+
+    def __init__(self, supply: SimulatedSupply, channel: int = 1):
+        self.supply = supply
+        self.plant = supply.plants[channel - 1]
+        self.function = 'CURR'
+        self.levels = {'CURR': 0.0, 'RES': 1000.0}
+        self.enabled = False
+        self.response = ''
+        # the load meters more accurately than the supply
+        self.current_noise = 50e-6
+        self.voltage_noise = 50e-6
+
+    def _apply(self):
+        self.plant.load = (self.function, self.levels[self.function]) if self.enabled else None
+
+    def send(self, command: str):
+        header, _, args = command.strip().partition(' ')
+        header = header.upper()
+        with self.supply.lock:
+            self.plant.update(self.supply.now())
+            if header == '*RST':
+                self.function = 'CURR'
+                self.levels = {'CURR': 0.0, 'RES': 1000.0}
+                self.enabled = False
+            elif header in ('FUNCTION', 'FUNC', ':SOURCE:FUNCTION', ':SOUR:FUNC'):
+                self.function = 'RES' if args.strip().upper().startswith('RES') else 'CURR'
+            elif header in ('CURRENT', 'CURR', ':SOURCE:CURRENT', ':SOUR:CURR'):
+                self.levels['CURR'] = parse_value(args, 'A')
+            elif header in ('RESISTANCE', 'RES', ':SOURCE:RESISTANCE', ':SOUR:RES'):
+                self.levels['RES'] = parse_value(args, 'OHM')
+            elif header in ('INPUT', 'INP', ':SOURCE:INPUT', ':SOUR:INP'):
+                self.enabled = args.strip().upper() in ('ON', '1')
+            elif header in ('MEASURE:CURRENT?', 'MEAS:CURR?', ':MEASURE:CURRENT?', ':MEAS:CURR?'):
+                self.response = f'{self.plant.current + self.supply.rng.gauss(0, self.current_noise):.6f}'
+            elif header in ('MEASURE:VOLTAGE?', 'MEAS:VOLT?', ':MEASURE:VOLTAGE?', ':MEAS:VOLT?'):
+                self.response = f'{self.plant.voltage + self.supply.rng.gauss(0, self.voltage_noise):.6f}'
+            else:
+                raise ValueError(f'SimulatedLoad: unsupported command {command}')
+            self._apply()
+
+    def receive(self) -> str:
+        response, self.response = self.response, ''
+        return response
+
+
+def selftest():
+    supply = SimulatedSupply(seed=1)
+    load = SimulatedLoad(supply)
+
+    assert supply.execute('*IDN?') == [IDN]
+    assert supply.execute('SOUR:VOLT 5;VOLT?') == ['5.000']
+    supply.execute('APPL 5.0V, 1.0A;OUTP ON')
+    load.send('Function Current')
+    load.send('Current 0.5A')
+    load.send('Input On')
+    supply.advance(0.1)
+
+    current = float(supply.execute('MEAS:CURR?')[0])
+    assert abs(current - 0.5) < 0.01, current
+    voltage = float(supply.execute('MEASure:SCALar:VOLTage:DC?')[0])
+    assert abs(voltage - 4.99) < 0.02, voltage
+
+    # more current than the limit: the supply goes into constant current
+    load.send('Current 2A')
+    supply.advance(0.1)
+    assert supply.plant.is_cc_mode()
+    assert abs(float(supply.execute('MEAS:CURR?')[0]) - 1.0) < 0.02
+
+    supply.execute('FOO')
+    assert supply.execute('SYST:ERR?') == ['-113,"Undefined header"']
+
+    # same seed and commands, same readings
+    readings = []
+    for _ in range(2):
+        sim = SimulatedSupply(seed=5)
+        sim.execute('APPL 3,1;OUTP ON')
+        sim.advance(0.01)
+        readings.append(sim.execute('MEAS:VOLT?;MEAS:CURR?'))
+    assert readings[0] == readings[1], readings
+    print('simulator selftest passed')
+
+
+if __name__ == '__main__':
+    selftest()
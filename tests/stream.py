@@ -0,0 +1,180 @@
+import struct
+import sys
+import time
+
+# decoder for the measurement stream of the M5 Stack Supply (SENSe:STReam)
+# frames start with 0xA5 0x5A, everything else on the link are SCPI responses. Text responses never contain 0xA5,
+# definite length blocks (#<n><length><data>) are skipped by their length, as their data may contain the sync bytes.
+# A frame is only accepted if its CRC matches, otherwise the search for the sync bytes continues with the next byte.
+
+SYNC = b'\xA5\x5A'
+
+
+def crc16(data: bytes) -> int:
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+class Frame:
+    def __init__(self, sequence, timestamp, channels):
+        self.sequence = sequence
+        # µs since boot of the supply
+        self.timestamp = timestamp
+        # channel number (starting at 1) -> (voltage, current, enabled, cc_mode, connected)
+        self.channels = channels
+
+
+class StreamDecoder:
+    def __init__(self):
+        self.buffer = bytearray()
+        self.last_sequence = None
+        self.frames = 0
+        self.dropped = 0
+        self.crc_errors = 0
+        self.block_end = False
+
+    # feed received bytes, returns a list of decoded frames, response lines (str) and blocks (bytes)
+    def feed(self, data: bytes) -> list:
+        self.buffer += data
+        out = []
+        while self.buffer:
+            if self.buffer[0] == SYNC[0]:
+                if len(self.buffer) < 3:
+                    break
+                if self.buffer[1] != SYNC[1]:
+                    del self.buffer[0]
+                    continue
+                size = 3 + self.buffer[2] + 2
+                if len(self.buffer) < size:
+                    break
+                raw = bytes(self.buffer[:size])
+                if crc16(raw[2:-2]) != struct.unpack('<H', raw[-2:])[0]:
+                    # not a valid frame, resync on the next byte
+                    self.crc_errors += 1
+                    del self.buffer[0]
+                    continue
+                del self.buffer[:size]
+                out.append(self._decode(raw))
+            elif self.buffer[0] == ord('#'):
+                block = self._block_size()
+                if block is None:
+                    break
+                out.append(bytes(self.buffer[:block]))
+                del self.buffer[:block]
+                self.block_end = True
+            else:
+                end = self.buffer.find(b'\r\n')
+                sync = self.buffer.find(SYNC)
+                if end < 0 or 0 <= sync < end:
+                    if sync > 0:
+                        # partial garbage in front of a frame
+                        del self.buffer[:sync]
+                        continue
+                    break
+                # the line end of a block response
+                if end > 0 or not self.block_end:
+                    out.append(bytes(self.buffer[:end]).decode(errors='replace'))
+                self.block_end = False
+                del self.buffer[:end + 2]
+        return out
+
+    # size of the definite length block at the start of the buffer, None while it is incomplete
+    def _block_size(self):
+        if len(self.buffer) < 2:
+            return None
+        digits = self.buffer[1] - ord('0')
+        if not 1 <= digits <= 9:
+            # #0 indefinite length block, ends with the line end
+            end = self.buffer.find(b'\r\n')
+            return end if end >= 0 else None
+        if len(self.buffer) < 2 + digits:
+            return None
+        size = 2 + digits + int(self.buffer[2:2 + digits])
+        return size if len(self.buffer) >= size else None
+
+    def _decode(self, raw: bytes) -> Frame:
+        sequence, timestamp, mask = struct.unpack('<HIB', raw[3:10])
+        channels = {}
+        pos = 10
+        for ch in range(8):
+            if mask & 1 << ch:
+                v, i, flags = struct.unpack('<ffB', raw[pos:pos + 9])
+                channels[ch + 1] = (v, i, bool(flags & 1), bool(flags & 2), bool(flags & 4))
+                pos += 9
+
+        if self.last_sequence is not None:
+            self.dropped += (sequence - self.last_sequence - 1) & 0xFFFF
+        self.last_sequence = sequence
+        self.frames += 1
+        return Frame(sequence, timestamp, channels)
+
+
+def selftest():
+    # frame 1, a response, a block containing the sync bytes, a notification, frame 2 with a broken CRC and frame 4
+    data = bytes.fromhex(
+        'a55a100100e8030000010000a0400000803e053639'
+        '352e3030300d0a'
+        '233135a55a0102030d0a'
+        '2153544154555320302c3531320d0a'
+        'a55a100200d0070000010000a0400000803e058464'
+        'a55a100400a00f000001000040410000c03f077e8c')
+
+    # all at once and byte by byte, as the serial port may split the data anywhere
+    for step in (len(data), 1):
+        decoder = StreamDecoder()
+        items = []
+        for pos in range(0, len(data), step):
+            items += decoder.feed(data[pos:pos + step])
+
+        assert len(items) == 5
+        assert isinstance(items[0], Frame) and items[0].sequence == 1 and items[0].timestamp == 1000
+        assert items[0].channels == {1: (5.0, 0.25, True, False, True)}
+        assert items[1:4] == ['5.000', b'#15\xA5\x5A\x01\x02\x03', '!STATUS 0,512']
+        assert isinstance(items[4], Frame) and items[4].sequence == 4
+        assert items[4].channels == {1: (12.0, 1.5, True, True, True)}
+        assert decoder.frames == 2 and decoder.crc_errors == 1 and decoder.dropped == 2
+        assert not decoder.buffer
+
+    print('stream decoder selftest passed')
+
+
+def run(port: str, duration: float, rate: int, mask: int):
+    import serial
+    link = serial.Serial(port, 115200, timeout=0.05)
+    link.write(f'SENS:STR:RATE {rate};CHAN {mask};STAT ON\r\n'.encode())
+
+    decoder = StreamDecoder()
+    responses = 0
+    start = time.time()
+    next_query = start
+    while time.time() - start < duration:
+        # queries still work while streaming
+        if time.time() >= next_query:
+            link.write(b'MEAS:VOLT?\r\n')
+            next_query += 1
+        for item in decoder.feed(link.read(4096)):
+            if isinstance(item, str):
+                responses += 1
+
+    link.write(b'SENS:STR:STAT OFF\r\n')
+    time.sleep(0.1)
+    decoder.feed(link.read(4096))
+
+    print(f'frames: {decoder.frames}, dropped: {decoder.dropped}, crc errors: {decoder.crc_errors}, '
+          f'responses: {responses}, rate: {decoder.frames / duration:.1f} Hz')
+    return decoder.dropped == 0 and decoder.crc_errors == 0
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 2:
+        print(f'usage: {sys.argv[0]} <port>|--selftest')
+        sys.exit(2)
+    if sys.argv[1] == '--selftest':
+        selftest()
+        sys.exit(0)
+    ok = run(sys.argv[1], 10, 200, 0x03)
+    sys.exit(0 if ok else 1)